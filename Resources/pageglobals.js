@@ -1,2 +1,104 @@
 var qWidgetName = "%1";
 var qWsServerUrl = "ws://localhost:%2";
+
+// Decodes a binary frame sent by the data server.
+// Set websocket.binaryType = "arraybuffer" to receive binary frames as ArrayBuffers.
+// Returns { plugin, source, data } where data is an ArrayBuffer of the payload,
+// or { channel, data } for widgets that subscribed with "compact": true,
+// or { plugin, source, channel, columns, next, times, values } for a reply to a
+// raw "history" request. columns holds the column names, times the sample times in
+// msec and values one array per column. next is the "from" to request the
+// following page with, or -1 once the range is complete.
+// Returns null if the frame is none of these.
+function quasarParseBlob(buffer) {
+    if (!(buffer instanceof ArrayBuffer)) {
+        return null;
+    }
+
+    var bytes = new Uint8Array(buffer);
+
+    // compact header, channel id as u32 little endian
+    if (bytes.length >= 5 && bytes[0] === 2) {
+        var channel = new DataView(buffer).getUint32(1, true);
+        return { channel: channel, data: buffer.slice(5) };
+    }
+
+    // header version
+    if (bytes.length < 3 || (bytes[0] !== 1 && bytes[0] !== 3)) {
+        return null;
+    }
+
+    var decoder = new TextDecoder("utf-8");
+    var pos = 1;
+
+    var codeLen = bytes[pos++];
+    if (pos + codeLen >= bytes.length) {
+        return null;
+    }
+    var plugin = decoder.decode(bytes.subarray(pos, pos + codeLen));
+    pos += codeLen;
+
+    var srcLen = bytes[pos++];
+    if (pos + srcLen > bytes.length) {
+        return null;
+    }
+    var source = decoder.decode(bytes.subarray(pos, pos + srcLen));
+    pos += srcLen;
+
+    if (bytes[0] === 1) {
+        return { plugin: plugin, source: source, data: buffer.slice(pos) };
+    }
+
+    return quasarParseHistory(buffer, pos, plugin, source);
+}
+
+// History frame after the plugin and source: little endian u32 channel, u32 columns,
+// u32 records, i64 next, u32 names size, the column names joined by "\n", zero padding
+// to a multiple of 8 bytes, then records of [i64 msec][f64 per column]
+function quasarParseHistory(buffer, pos, plugin, source) {
+    var view = new DataView(buffer);
+
+    // i64 as a Number, exact for msec timestamps
+    function int64(at) {
+        return view.getInt32(at + 4, true) * 4294967296 + view.getUint32(at, true);
+    }
+
+    if (pos + 24 > buffer.byteLength) {
+        return null;
+    }
+
+    var channel = view.getUint32(pos, true);
+    var columns = view.getUint32(pos + 4, true);
+    var records = view.getUint32(pos + 8, true);
+    var next = int64(pos + 12);
+    var namesLen = view.getUint32(pos + 20, true);
+    pos += 24;
+
+    if (pos + namesLen > buffer.byteLength) {
+        return null;
+    }
+
+    var names = namesLen ? new TextDecoder("utf-8").decode(new Uint8Array(buffer, pos, namesLen)).split("\n") : [];
+    pos += namesLen;
+    pos += (8 - pos % 8) % 8;
+
+    var recordSize = 8 * (1 + columns);
+    if (names.length !== columns || pos + records * recordSize > buffer.byteLength) {
+        return null;
+    }
+
+    var times = new Float64Array(records);
+    var values = [];
+    for (var c = 0; c < columns; c++) {
+        values.push(new Float64Array(records));
+    }
+
+    for (var i = 0; i < records; i++, pos += recordSize) {
+        times[i] = int64(pos);
+        for (var c = 0; c < columns; c++) {
+            values[c][i] = view.getFloat64(pos + 8 * (1 + c), true);
+        }
+    }
+
+    return { plugin: plugin, source: source, channel: channel, columns: names, next: next, times: times, values: values };
+}
@@ -0,0 +1,161 @@
+#include "configstore.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QSettings>
+#include <QThread>
+#include <QTimer>
+
+namespace
+{
+    ConfigStore* s_configStore = nullptr;
+
+    void write_settings(const QVariantMap& values)
+    {
+        QSettings settings;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+        // Write to a temporary file and replace, so a crash never leaves a truncated config
+        settings.setAtomicSyncRequired(true);
+#endif
+
+        for (auto it = values.cbegin(); it != values.cend(); ++it)
+        {
+            settings.setValue(it.key(), it.value());
+        }
+
+        settings.sync();
+
+        if (settings.status() != QSettings::NoError)
+        {
+            qWarning() << "Failed to write settings to" << settings.fileName();
+        }
+    }
+
+    class ConfigWriter : public QRunnable
+    {
+    public:
+        explicit ConfigWriter(QVariantMap values)
+            : m_values(std::move(values)) {}
+
+        virtual void run() override { write_settings(m_values); }
+
+    private:
+        QVariantMap m_values;
+    };
+}
+
+ConfigStore::~ConfigStore()
+{
+    m_flushTimer->stop();
+    m_flushPool.waitForDone();
+
+    flush();
+
+    s_configStore = nullptr;
+}
+
+ConfigStore::ConfigStore(QObject* parent)
+    : QObject(parent)
+{
+    if (nullptr != s_configStore)
+    {
+        throw std::runtime_error("config store already created");
+    }
+
+    s_configStore = this;
+
+    QSettings settings;
+
+    for (const QString& key : settings.allKeys())
+    {
+        m_values.insert(key, settings.value(key));
+    }
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(QUASAR_CONFIG_FLUSH_DELAY);
+
+    connect(m_flushTimer, &QTimer::timeout, this, &ConfigStore::flushAsync);
+
+    // Keep writes in order
+    m_flushPool.setMaxThreadCount(1);
+}
+
+ConfigStore* ConfigStore::instance()
+{
+    return s_configStore;
+}
+
+QVariant ConfigStore::value(const QString& key, const QVariant& defaultValue) const
+{
+    QReadLocker lock(&m_lock);
+
+    auto it = m_values.constFind(key);
+
+    return (it != m_values.cend()) ? it.value() : defaultValue;
+}
+
+void ConfigStore::setValue(const QString& key, const QVariant& value)
+{
+    {
+        QWriteLocker lock(&m_lock);
+
+        auto it = m_values.find(key);
+
+        if (it != m_values.end() && it.value() == value)
+        {
+            return;
+        }
+
+        m_values.insert(key, value);
+        m_dirty.insert(key, value);
+    }
+
+    if (QThread::currentThread() == thread())
+    {
+        if (!m_flushTimer->isActive())
+        {
+            m_flushTimer->start();
+        }
+    }
+    else
+    {
+        QMetaObject::invokeMethod(m_flushTimer, "start", Qt::QueuedConnection);
+    }
+
+    emit valueChanged(key, value);
+}
+
+void ConfigStore::flush()
+{
+    QVariantMap dirty = takeDirty();
+
+    // Earlier background writes must land first
+    m_flushPool.waitForDone();
+
+    if (!dirty.isEmpty())
+    {
+        write_settings(dirty);
+    }
+}
+
+void ConfigStore::flushAsync()
+{
+    QVariantMap dirty = takeDirty();
+
+    if (!dirty.isEmpty())
+    {
+        m_flushPool.start(new ConfigWriter(std::move(dirty)));
+    }
+}
+
+QVariantMap ConfigStore::takeDirty()
+{
+    QWriteLocker lock(&m_lock);
+
+    QVariantMap dirty;
+    dirty.swap(m_dirty);
+
+    return dirty;
+}
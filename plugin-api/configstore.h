@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QVariant>
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif
+
+// Delay before dirty values are written out, so bursts of changes are batched
+#define QUASAR_CONFIG_FLUSH_DELAY 500
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+// In-memory view of the application settings.
+// All values are read once at construction, reads never touch disk.
+// Changes are written back in batches on a background thread.
+class PAPI_EXPORT ConfigStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~ConfigStore();
+    explicit ConfigStore(QObject* parent = nullptr);
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore(ConfigStore&&)      = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+    ConfigStore& operator=(ConfigStore&&) = delete;
+
+    static ConfigStore* instance();
+
+    QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+    void     setValue(const QString& key, const QVariant& value);
+
+    template <typename T>
+    T get(const QString& key, const T& defaultValue = T()) const
+    {
+        return value(key, QVariant::fromValue(defaultValue)).template value<T>();
+    }
+
+    // Writes all pending changes before returning
+    void flush();
+
+signals:
+    void valueChanged(QString key, QVariant value);
+
+private slots:
+    void flushAsync();
+
+private:
+    QVariantMap takeDirty();
+
+    mutable QReadWriteLock   m_lock;
+    QHash<QString, QVariant> m_values;
+    QVariantMap              m_dirty;
+
+    QTimer*     m_flushTimer;
+    QThreadPool m_flushPool;
+};
@@ -0,0 +1,296 @@
+#include "datahistory.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
+DataHistory::DataHistory(qint64 windowMsec, int64_t refreshMsec, size_t maxBytes)
+    : m_window(windowMsec), m_refresh(refreshMsec), m_maxbytes(maxBytes)
+{
+}
+
+QJsonObject HistoryView::empty()
+{
+    return QJsonObject{ { "t", QJsonArray() }, { "columns", QJsonObject() } };
+}
+
+bool DataHistory::extract(const QJsonValue& data, bool& sameFields)
+{
+    m_scratch.clear();
+
+    if (data.isDouble())
+    {
+        m_scratch.push_back(data.toDouble());
+        sameFields = (m_fields.size() == 1 && m_fields[0] == "value");
+        return true;
+    }
+
+    if (!data.isObject())
+    {
+        return false;
+    }
+
+    QJsonObject obj = data.toObject();
+
+    if (obj.isEmpty())
+    {
+        return false;
+    }
+
+    sameFields = (obj.size() == m_fields.size());
+
+    int i = 0;
+
+    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it, ++i)
+    {
+        if (!it.value().isDouble())
+        {
+            return false;
+        }
+
+        m_scratch.push_back(it.value().toDouble());
+        sameFields = sameFields && (it.key() == m_fields[i]);
+    }
+
+    return true;
+}
+
+void DataHistory::reset(const QStringList& fields)
+{
+    m_fields = fields;
+
+    // Enough samples to cover the window, within the memory cap
+    size_t bytesPerSample = sizeof(qint64) + sizeof(double) * m_fields.size();
+    size_t capacity       = m_maxbytes / bytesPerSample;
+
+    if (m_refresh > 0)
+    {
+        capacity = std::min<size_t>(capacity, m_window / m_refresh + 1);
+    }
+
+    m_capacity = std::max<size_t>(capacity, 1);
+    m_head     = 0;
+    m_count    = 0;
+
+    m_time.assign(m_capacity, 0);
+    m_columns.assign(m_fields.size(), std::vector<double>(m_capacity));
+}
+
+bool DataHistory::record(qint64 msec, const QJsonValue& data)
+{
+    bool sameFields = false;
+
+    if (!extract(data, sameFields))
+    {
+        return false;
+    }
+
+    if (!sameFields)
+    {
+        reset(data.isObject() ? data.toObject().keys() : QStringList{ "value" });
+    }
+
+    append(msec);
+
+    return true;
+}
+
+bool DataHistory::record(qint64 msec, const QStringList& fields, const std::vector<double>& values)
+{
+    if (fields.isEmpty() || (size_t) fields.size() != values.size())
+    {
+        return false;
+    }
+
+    m_scratch = values;
+
+    if (fields != m_fields)
+    {
+        reset(fields);
+    }
+
+    append(msec);
+
+    return true;
+}
+
+void DataHistory::append(qint64 msec)
+{
+    // Keep times ordered if the wall clock went back
+    if (m_count && msec < m_time[at(m_count - 1)])
+    {
+        msec = m_time[at(m_count - 1)];
+    }
+
+    // Drop samples that fell out of the window
+    while (m_count && m_time[m_head] < msec - m_window)
+    {
+        m_head = (m_head + 1) % m_capacity;
+        m_count--;
+    }
+
+    size_t slot;
+
+    if (m_count == m_capacity)
+    {
+        slot   = m_head;
+        m_head = (m_head + 1) % m_capacity;
+    }
+    else
+    {
+        slot = at(m_count);
+        m_count++;
+    }
+
+    m_time[slot] = msec;
+
+    for (size_t c = 0; c < m_columns.size(); c++)
+    {
+        m_columns[c][slot] = m_scratch[c];
+    }
+}
+
+size_t HistoryView::lowerBound(qint64 msec) const
+{
+    size_t lo = 0;
+    size_t hi = count();
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+
+        if (time(mid) < msec)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+size_t HistoryView::samples(qint64 from, qint64 to, size_t max, QByteArray& out, qint64& next) const
+{
+    next = -1;
+
+    if (isEmpty() || from > to)
+    {
+        return 0;
+    }
+
+    size_t n     = count();
+    size_t first = lowerBound(from);
+    size_t end   = first;
+
+    while (end < n && end - first < max && time(end) <= to)
+    {
+        end++;
+    }
+
+    if (end < n && end - first == max && time(end) <= to)
+    {
+        next = time(end);
+    }
+
+    size_t recordsize = sizeof(qint64) + sizeof(double) * fields().size();
+    int    offset     = out.size();
+
+    out.resize(offset + (int) ((end - first) * recordsize));
+    copyRecords(first, end - first, out.data() + offset);
+
+    return end - first;
+}
+
+void HistoryView::copyRecords(size_t first, size_t count, char* out) const
+{
+    size_t ncols = fields().size();
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        qint64 msec = time(i);
+
+        std::memcpy(out, &msec, sizeof(msec));
+        out += sizeof(msec);
+
+        for (size_t c = 0; c < ncols; c++)
+        {
+            double v = value(i, c);
+
+            std::memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+    }
+}
+
+QJsonObject HistoryView::buckets(qint64 from, qint64 to, int count) const
+{
+    if (isEmpty() || from > to || count <= 0)
+    {
+        return empty();
+    }
+
+    count = std::min(count, QUASAR_HISTORY_MAX_BUCKETS);
+
+    qint64 span  = to - from + 1;
+    size_t ncols = fields().size();
+    size_t total = this->count();
+
+    std::vector<int>    n(count, 0);
+    std::vector<double> mins(count * ncols, std::numeric_limits<double>::max());
+    std::vector<double> maxs(count * ncols, std::numeric_limits<double>::lowest());
+    std::vector<double> sums(count * ncols, 0.0);
+
+    for (size_t i = lowerBound(from); i < total && time(i) <= to; i++)
+    {
+        size_t b = (size_t) ((time(i) - from) * count / span);
+
+        n[b]++;
+
+        for (size_t c = 0; c < ncols; c++)
+        {
+            double v = value(i, c);
+            size_t k = b * ncols + c;
+
+            mins[k] = std::min(mins[k], v);
+            maxs[k] = std::max(maxs[k], v);
+            sums[k] += v;
+        }
+    }
+
+    QJsonArray                             t;
+    std::vector<std::array<QJsonArray, 3>> cols(ncols);
+
+    for (int b = 0; b < count; b++)
+    {
+        if (!n[b])
+        {
+            continue;
+        }
+
+        t.append(from + span * b / count);
+
+        for (size_t c = 0; c < ncols; c++)
+        {
+            size_t k = b * ncols + c;
+
+            cols[c][0].append(mins[k]);
+            cols[c][1].append(maxs[k]);
+            cols[c][2].append(sums[k] / n[b]);
+        }
+    }
+
+    QJsonObject columns;
+
+    for (size_t c = 0; c < ncols; c++)
+    {
+        columns[fields()[c]] = QJsonObject{ { "min", cols[c][0] }, { "max", cols[c][1] }, { "avg", cols[c][2] } };
+    }
+
+    return QJsonObject{ { "t", t }, { "columns", columns } };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QStringList>
+
+#include <vector>
+
+// Once a source has recorded a sample it keeps being fetched at its refresh rate,
+// or whenever its plugin signals, with no widget subscribed or while every widget
+// is hidden, so its history has no gaps. Polled sources are only recorded when polled
+#define QUASAR_CONFIG_HISTORYWINDOW "global/historyWindow"
+#define QUASAR_CONFIG_HISTORYMAXBYTES "global/historyMaxBytes"
+
+// One hour of samples, at most 1MB per source
+#define QUASAR_HISTORY_DEFAULT_WINDOW 3600
+#define QUASAR_HISTORY_DEFAULT_MAXBYTES (1024 * 1024)
+
+// Upper bound on the buckets of one downsampled range query
+#define QUASAR_HISTORY_MAX_BUCKETS 4096
+
+// Upper bound on the samples of one raw range query, the rest is paged
+#define QUASAR_HISTORY_MAX_SAMPLES 65536
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif
+
+// Time ordered samples with fixed columns, read by index
+class PAPI_EXPORT HistoryView
+{
+public:
+    virtual ~HistoryView() = default;
+
+    virtual const QStringList& fields() const = 0;
+
+    virtual size_t count() const                        = 0;
+    virtual qint64 time(size_t i) const                 = 0;
+    virtual double value(size_t i, size_t column) const = 0;
+
+    bool isEmpty() const { return count() == 0; }
+
+    // Appends up to max samples within [from, to] to out as [qint64 msec][double x columns]
+    // records in host byte order and returns how many. next is the time to continue
+    // from if the range did not fit, -1 otherwise
+    size_t samples(qint64 from, qint64 to, size_t max, QByteArray& out, qint64& next) const;
+
+    // [from, to] split into count equal buckets as
+    // {"t":[bucket start],"columns":{"<field>":{"min":[...],"max":[...],"avg":[...]}}}.
+    // Buckets without samples are left out
+    QJsonObject buckets(qint64 from, qint64 to, int count) const;
+
+    static QJsonObject empty();
+
+protected:
+    size_t lowerBound(qint64 msec) const;
+
+    // Writes count records starting at first to out
+    virtual void copyRecords(size_t first, size_t count, char* out) const;
+};
+
+// Recent numeric values of one data source, kept as a ring buffer of columns.
+// A source sending numbers has a single "value" column, one sending flat
+// objects of numbers has a column per member. Anything else is not recorded
+class PAPI_EXPORT DataHistory : public HistoryView
+{
+public:
+    DataHistory(qint64 windowMsec, int64_t refreshMsec, size_t maxBytes);
+
+    // Returns false if data was not recorded
+    bool record(qint64 msec, const QJsonValue& data);
+    bool record(qint64 msec, const QStringList& fields, const std::vector<double>& values);
+
+    // Values of the latest record() call
+    const double* lastValues() const { return m_scratch.data(); }
+
+    const QStringList& fields() const override { return m_fields; }
+
+    size_t count() const override { return m_count; }
+    qint64 time(size_t i) const override { return m_time[at(i)]; }
+    double value(size_t i, size_t column) const override { return m_columns[column][at(i)]; }
+
+private:
+    bool   extract(const QJsonValue& data, bool& sameFields);
+    void   reset(const QStringList& fields);
+    void   append(qint64 msec); // m_scratch as the sample at msec
+    size_t at(size_t i) const { return (m_head + i) % m_capacity; } // i-th oldest sample
+
+    qint64  m_window;
+    int64_t m_refresh;
+    size_t  m_maxbytes;
+
+    QStringList                      m_fields;
+    std::vector<qint64>              m_time;
+    std::vector<std::vector<double>> m_columns;
+    std::vector<double>              m_scratch;
+
+    size_t m_capacity = 0;
+    size_t m_head     = 0;
+    size_t m_count    = 0;
+};
@@ -1,14 +1,34 @@
 #include "dataplugin.h"
 
+#include "configstore.h"
+#include "plugintasks.h"
+
 #include <plugin_support_internal.h>
 
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLibrary>
-#include <QSettings>
+#include <QStandardPaths>
 #include <QTimer>
 #include <QtWebSockets/QWebSocket>
 
+#include <algorithm>
+
+namespace
+{
+    // Compact JSON text of any value type
+    QByteArray to_json_value(const QJsonValue& val)
+    {
+        // Only arrays and objects can be serialized directly, so wrap and strip the brackets
+        QByteArray arr = QJsonDocument(QJsonArray{ val }).toJson(QJsonDocument::Compact);
+
+        return arr.mid(1, arr.size() - 2);
+    }
+}
+
 // Ensure c strings are null terminated
 // and converted to utf8 QString
 #define CHAR_TO_UTF8(d, x) \
@@ -36,7 +56,14 @@ DataPlugin::DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QStr
         throw std::runtime_error("Invalid plugin name or code");
     }
 
-    QSettings settings;
+    ConfigStore& settings = *ConfigStore::instance();
+
+    m_trustedjson = settings.value(getSettingsCode(QUASAR_DP_TRUSTEDJSON), false).toBool();
+
+    m_historywindow   = settings.value(QUASAR_CONFIG_HISTORYWINDOW, QUASAR_HISTORY_DEFAULT_WINDOW).toLongLong() * 1000;
+    m_historymaxbytes = settings.value(QUASAR_CONFIG_HISTORYMAXBYTES, QUASAR_HISTORY_DEFAULT_MAXBYTES).toULongLong();
+
+    m_historyretention = settings.value(QUASAR_CONFIG_HISTORYRETENTION, 0).toLongLong() * 24 * 3600 * 1000;
 
     // register data sources
     if (nullptr != m_plugin->dataSources)
@@ -58,6 +85,34 @@ DataPlugin::DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QStr
             source.uid = m_plugin->dataSources[i].uid = ++DataPlugin::_uid;
             source.refreshmsec                        = settings.value(getSettingsCode(QUASAR_DP_REFRESH_PREFIX + source.key), (qlonglong) m_plugin->dataSources[i].refreshMsec).toLongLong();
             source.enabled                            = settings.value(getSettingsCode(QUASAR_DP_ENABLED_PREFIX + source.key), true).toBool();
+            source.nonnumeric                         = false;
+
+            // Everything after the payload is fixed per source
+            source.envelope = ",\"type\":\"data\",\"plugin\":" + to_json_value(getCode()) + ",\"source\":" + to_json_value(source.key) + "}";
+
+            // [version][code length][code][source length][source]
+            QByteArray code = getCode().toUtf8();
+            QByteArray key  = source.key.toUtf8();
+
+            source.blobheader.append((char) QUASAR_DP_BLOB_VERSION);
+            source.blobheader.append((char) code.size()).append(code);
+            source.blobheader.append((char) key.size()).append(key);
+
+            // Channel id frames: {"data":...,"channel":uid} and [version][uid as u32 LE]
+            source.compactenvelope = ",\"channel\":" + QByteArray::number((qulonglong) source.uid) + "}";
+
+            source.compactblobheader.append((char) QUASAR_DP_BLOB_COMPACT_VERSION);
+
+            for (int b = 0; b < 4; b++)
+            {
+                source.compactblobheader.append((char) ((source.uid >> (8 * b)) & 0xFF));
+            }
+
+            // Reopen history kept by a previous run
+            if (m_historyretention > 0 && QDir(getHistoryPath(source)).exists())
+            {
+                source.store = std::make_unique<HistoryStore>(getHistoryPath(source), m_historyretention);
+            }
 
             // If data source is plugin signaled or async poll
             if (source.refreshmsec <= 0)
@@ -95,6 +150,8 @@ DataPlugin::DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QStr
                         break;
                 }
 
+                quasar_publish_setting(m_settings.get(), it->second);
+
                 ++it;
             }
 
@@ -102,6 +159,11 @@ DataPlugin::DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QStr
         }
     }
 
+    // timers of batched plugins are aligned to this
+    m_epoch.start();
+
+    m_tasks = std::make_unique<PluginTasks>(m_code);
+
     // initialize the plugin
     if (!m_plugin->init(this))
     {
@@ -109,13 +171,42 @@ DataPlugin::DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QStr
     }
 }
 
+void DataMessage::sendTo(QWebSocket* socket, bool compact) const
+{
+    if (compact && !compactbinary.isEmpty())
+    {
+        socket->sendBinaryMessage(compactbinary);
+    }
+    else if (compact && !compacttext.isEmpty())
+    {
+        socket->sendTextMessage(compacttext);
+    }
+    else if (!binary.isEmpty())
+    {
+        socket->sendBinaryMessage(binary);
+    }
+    else
+    {
+        socket->sendTextMessage(text);
+    }
+}
+
 DataPlugin::~DataPlugin()
 {
+    // Ask background tasks to stop, give the plugin a chance to
+    // wake them up in shutdown(), then wait for them to finish
+    m_tasks->cancelAll();
+
     if (nullptr != m_plugin->shutdown)
     {
         m_plugin->shutdown(this);
     }
 
+    m_tasks->waitAll();
+
+    qInfo() << "Plugin " << m_code << " background tasks used " << m_tasks->cpuTimeMsec() << "ms CPU time";
+    m_tasks.reset();
+
     // Do some explicit cleanup
     for (auto& src : m_datasources)
     {
@@ -123,6 +214,8 @@ DataPlugin::~DataPlugin()
         src.second.locks.reset();
 
         src.second.subscribers.clear();
+        src.second.suspended.clear();
+        src.second.compact.clear();
     }
 
     // plugin is responsible for cleanup of quasar_plugin_info_t*
@@ -169,7 +262,7 @@ DataPlugin* DataPlugin::load(QString libpath, QObject* parent /*= Q_NULLPTR*/)
     return nullptr;
 }
 
-bool DataPlugin::addSubscriber(QString source, QWebSocket* subscriber, QString widgetName)
+bool DataPlugin::addSubscriber(QString source, QWebSocket* subscriber, QString widgetName, bool compact)
 {
     if (!subscriber)
     {
@@ -177,23 +270,47 @@ bool DataPlugin::addSubscriber(QString source, QWebSocket* subscriber, QString w
         return false;
     }
 
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code << " by widget " << widgetName;
         return false;
     }
 
+    addSubscriber(it->second, subscriber, compact);
+
+    return true;
+}
+
+bool DataPlugin::addSubscriber(DataSource& data, QWebSocket* subscriber, bool compact)
+{
     // TODO maybe needs locks
-    DataSource& data = m_datasources[source];
+    bool first = data.subscribers.empty();
 
     data.subscribers.insert(subscriber);
 
+    if (compact)
+    {
+        data.compact.insert(subscriber);
+    }
+
     if (data.refreshmsec > 0)
     {
         createTimer(data);
     }
 
-    return true;
+    return first;
+}
+
+void DataPlugin::fetchSignaledData(DataSource& data)
+{
+    // Signals are dropped while nobody subscribes, and a plugin may hold off
+    // signaling again until its data is fetched, so fetch now
+    if (data.refreshmsec < 0 && !data.subscribers.empty())
+    {
+        broadcastData(data);
+    }
 }
 
 void DataPlugin::removeSubscriber(QWebSocket* subscriber)
@@ -210,13 +327,15 @@ void DataPlugin::removeSubscriber(QWebSocket* subscriber)
     while (it != m_datasources.end())
     {
         // Log if unsubscribed succeeded
-        if (it->second.subscribers.erase(subscriber))
+        if (it->second.subscribers.erase(subscriber) || it->second.suspended.erase(subscriber))
         {
             qInfo() << "Widget unsubscribed from plugin " << m_code << " data source " << it->first;
         }
 
+        it->second.compact.erase(subscriber);
+
         // Stop timer if no subscribers
-        if (it->second.subscribers.empty())
+        if (it->second.subscribers.empty() && !keepsSampling(it->second))
         {
             it->second.timer.reset();
         }
@@ -225,6 +344,67 @@ void DataPlugin::removeSubscriber(QWebSocket* subscriber)
     }
 }
 
+void DataPlugin::suspendSubscriber(QWebSocket* subscriber)
+{
+    for (auto& it : m_datasources)
+    {
+        DataSource& data = it.second;
+
+        // Subscribers of poll-only sources are a queue of pending polls, left to be answered
+        if (data.refreshmsec == 0)
+        {
+            continue;
+        }
+
+        if (data.subscribers.erase(subscriber))
+        {
+            data.suspended.insert(subscriber);
+
+            // Stop polling the plugin if nobody is watching
+            if (data.subscribers.empty() && !keepsSampling(data))
+            {
+                data.timer.reset();
+            }
+        }
+    }
+}
+
+void DataPlugin::resumeSubscriber(QWebSocket* subscriber)
+{
+    for (auto& it : m_datasources)
+    {
+        DataSource& data = it.second;
+
+        if (data.refreshmsec == 0)
+        {
+            continue;
+        }
+
+        if (data.suspended.erase(subscriber))
+        {
+            bool first = data.subscribers.empty();
+
+            data.subscribers.insert(subscriber);
+
+            if (data.refreshmsec > 0)
+            {
+                createTimer(data);
+            }
+
+            if (data.refreshmsec < 0 && first)
+            {
+                // Signals were dropped while every subscriber was suspended
+                fetchSignaledData(data);
+            }
+            else if (!data.lastmessage.isEmpty())
+            {
+                // Catch the widget up with the latest value
+                data.lastmessage.sendTo(subscriber, data.compact.count(subscriber));
+            }
+        }
+    }
+}
+
 void DataPlugin::pollAndSendData(QString source, QWebSocket* subscriber, QString widgetName)
 {
     if (!subscriber)
@@ -233,23 +413,30 @@ void DataPlugin::pollAndSendData(QString source, QWebSocket* subscriber, QString
         return;
     }
 
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code << " by widget " << widgetName;
         return;
     }
 
-    // TODO maybe needs locks
-    DataSource& data = m_datasources[source];
+    pollAndSendData(it->second, subscriber);
+}
 
-    QString message = craftDataMessage(data);
+void DataPlugin::pollAndSendData(DataSource& data, QWebSocket* subscriber)
+{
+    // TODO maybe needs locks
+    DataMessage message = craftDataMessage(data);
 
     if (!message.isEmpty())
     {
-        subscriber->sendTextMessage(message);
+        data.lastmessage = message;
+        message.sendTo(subscriber, data.compact.count(subscriber));
 
         // Pop client from poll queue if data was readily available
         data.subscribers.erase(subscriber);
+        data.compact.erase(subscriber);
     }
 }
 
@@ -257,24 +444,17 @@ void DataPlugin::sendDataToSubscribers(DataSource& source)
 {
     // TODO maybe needs locks
 
-    // Only send if there are subscribers
-    if (!source.subscribers.empty())
+    // Only send if there are subscribers, or the history needs the sample
+    if (!source.subscribers.empty() || keepsSampling(source))
     {
-        QString message = craftDataMessage(source);
-
-        if (!message.isEmpty())
-        {
-            for (auto sub : source.subscribers)
-            {
-                sub->sendTextMessage(message);
-            }
-        }
+        broadcastData(source);
     }
 
     if (source.refreshmsec == 0)
     {
-        // Clear poll queue
+        // Clear poll queue, compact polls only last until answered
         source.subscribers.clear();
+        source.compact.clear();
     }
 
     // Signal data processed
@@ -289,21 +469,43 @@ void DataPlugin::sendDataToSubscribers(DataSource& source)
     }
 }
 
+bool DataPlugin::keepsSampling(const DataSource& data) const
+{
+    // Polled sources have no schedule to keep
+    return data.refreshmsec != 0 && data.history && !data.nonnumeric;
+}
+
+void DataPlugin::broadcastData(DataSource& data)
+{
+    DataMessage message = craftDataMessage(data);
+
+    if (!message.isEmpty())
+    {
+        data.lastmessage = message;
+
+        for (auto sub : data.subscribers)
+        {
+            message.sendTo(sub, data.compact.count(sub));
+        }
+    }
+}
+
 void DataPlugin::setDataSourceEnabled(QString source, bool enabled)
 {
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = it->second;
 
     data.enabled = enabled;
 
     // Save to file
-    QSettings settings;
-    settings.setValue(getSettingsCode(QUASAR_DP_ENABLED_PREFIX + source), data.enabled);
+    ConfigStore::instance()->setValue(getSettingsCode(QUASAR_DP_ENABLED_PREFIX + source), data.enabled);
 
     if (data.enabled && data.refreshmsec > 0)
     {
@@ -319,19 +521,20 @@ void DataPlugin::setDataSourceEnabled(QString source, bool enabled)
 
 void DataPlugin::setDataSourceRefresh(QString source, int64_t msec)
 {
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = it->second;
 
     data.refreshmsec = msec;
 
     // Save to file
-    QSettings settings;
-    settings.setValue(getSettingsCode(QUASAR_DP_REFRESH_PREFIX + source), (qlonglong) data.refreshmsec);
+    ConfigStore::instance()->setValue(getSettingsCode(QUASAR_DP_REFRESH_PREFIX + source), (qlonglong) data.refreshmsec);
 
     // Refresh timer if exists
     if (nullptr != data.timer)
@@ -344,11 +547,16 @@ void DataPlugin::setCustomSetting(QString name, int val)
 {
     if (m_settings)
     {
-        m_settings->map[name].inttype.val = val;
+        auto it = m_settings->map.find(name);
+
+        if (it != m_settings->map.end())
+        {
+            it->second.inttype.val = val;
+            quasar_publish_setting(m_settings.get(), it->second);
 
-        // Save to file
-        QSettings settings;
-        settings.setValue(getSettingsCode(name), val);
+            // Save to file
+            ConfigStore::instance()->setValue(getSettingsCode(name), val);
+        }
     }
 }
 
@@ -356,11 +564,16 @@ void DataPlugin::setCustomSetting(QString name, double val)
 {
     if (m_settings)
     {
-        m_settings->map[name].doubletype.val = val;
+        auto it = m_settings->map.find(name);
+
+        if (it != m_settings->map.end())
+        {
+            it->second.doubletype.val = val;
+            quasar_publish_setting(m_settings.get(), it->second);
 
-        // Save to file
-        QSettings settings;
-        settings.setValue(getSettingsCode(name), val);
+            // Save to file
+            ConfigStore::instance()->setValue(getSettingsCode(name), val);
+        }
     }
 }
 
@@ -368,11 +581,16 @@ void DataPlugin::setCustomSetting(QString name, bool val)
 {
     if (m_settings)
     {
-        m_settings->map[name].booltype.val = val;
+        auto it = m_settings->map.find(name);
+
+        if (it != m_settings->map.end())
+        {
+            it->second.booltype.val = val;
+            quasar_publish_setting(m_settings.get(), it->second);
 
-        // Save to file
-        QSettings settings;
-        settings.setValue(getSettingsCode(name), val);
+            // Save to file
+            ConfigStore::instance()->setValue(getSettingsCode(name), val);
+        }
     }
 }
 
@@ -384,31 +602,35 @@ void DataPlugin::updatePluginSettings()
     }
 }
 
-void DataPlugin::emitDataReady(QString source)
+void DataPlugin::emitDataReady(const char* source)
 {
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = it->second;
 
     if (data.locks)
     {
-        emit dataReady(source);
+        emit dataReady(it->first);
     }
 }
 
-void DataPlugin::waitDataProcessed(QString source)
+void DataPlugin::waitDataProcessed(const char* source)
 {
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = it->second;
 
     if (data.locks)
     {
@@ -420,13 +642,15 @@ void DataPlugin::waitDataProcessed(QString source)
 
 void DataPlugin::sendDataToSubscribersByName(QString source)
 {
-    if (!m_datasources.count(source))
+    auto it = m_datasources.find(source);
+
+    if (it == m_datasources.end())
     {
         qWarning() << "Unknown data source " << source << " requested in plugin " << m_code;
         return;
     }
 
-    DataSource& data = m_datasources[source];
+    DataSource& data = it->second;
 
     sendDataToSubscribers(data);
 }
@@ -437,36 +661,249 @@ void DataPlugin::createTimer(DataSource& data)
     {
         // Initialize timer not done so
         data.timer = std::make_unique<QTimer>(this);
-        connect(data.timer.get(), &QTimer::timeout, [this, &data] { sendDataToSubscribers(data); });
 
-        data.timer->start(data.refreshmsec);
+        if (hasBatchSupport())
+        {
+            // Align to multiples of the refresh rate so sources with
+            // related rates come due together and can be batched
+            data.timer->setTimerType(Qt::PreciseTimer);
+
+            connect(data.timer.get(), &QTimer::timeout, [this, &data] {
+                if (data.timer->interval() != data.refreshmsec)
+                {
+                    data.timer->setInterval(data.refreshmsec);
+                }
+
+                queueDueSource(data);
+            });
+
+            data.timer->start(data.refreshmsec - (m_epoch.elapsed() % data.refreshmsec));
+        }
+        else
+        {
+            connect(data.timer.get(), &QTimer::timeout, [this, &data] { sendDataToSubscribers(data); });
+
+            data.timer->start(data.refreshmsec);
+        }
+    }
+}
+
+bool DataPlugin::hasBatchSupport()
+{
+    // field does not exist in older plugins
+    return m_plugin->api_version >= 2 && nullptr != m_plugin->get_data_batch;
+}
+
+void DataPlugin::queueDueSource(DataSource& data)
+{
+    if (m_duesources.empty())
+    {
+        // Let every timer that fired this tick queue up first
+        QTimer::singleShot(0, this, &DataPlugin::sendDueSources);
+    }
+
+    if (std::find(m_duesources.begin(), m_duesources.end(), &data) == m_duesources.end())
+    {
+        m_duesources.push_back(&data);
+    }
+}
+
+void DataPlugin::sendDueSources()
+{
+    std::vector<DataSource*> due;
+    due.swap(m_duesources);
+
+    // Sources may have lost their subscribers since being queued
+    due.erase(std::remove_if(due.begin(), due.end(), [this](DataSource* d) { return !d->enabled || (d->subscribers.empty() && !keepsSampling(*d)); }),
+              due.end());
+
+    if (due.empty())
+    {
+        return;
+    }
+
+    if (due.size() == 1)
+    {
+        sendDataToSubscribers(*due.front());
+        return;
+    }
+
+    size_t count = due.size();
+
+    std::vector<size_t>             uids;
+    std::vector<quasar_data_t>      replies(count);
+    std::vector<quasar_data_handle> handles;
+    std::unique_ptr<bool[]>         ok(new bool[count]());
+
+    uids.reserve(count);
+    handles.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        replies[i].trusted = m_trustedjson;
+        replies[i].history = m_historywindow > 0 && !due[i]->nonnumeric;
+
+        uids.push_back(due[i]->uid);
+        handles.push_back(&replies[i]);
+    }
+
+    if (!m_plugin->get_data_batch(uids.data(), handles.data(), ok.get(), count))
+    {
+        qWarning() << "getDataBatch(" << getCode() << ", " << count << " sources) failed";
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Failed entries are dropped, the others still go out
+        if (!ok[i])
+        {
+            qWarning() << "getDataBatch(" << getCode() << ", " << due[i]->key << ") failed";
+            continue;
+        }
+
+        DataMessage message = finishDataMessage(*due[i], replies[i]);
+
+        if (!message.isEmpty())
+        {
+            due[i]->lastmessage = message;
+
+            for (auto sub : due[i]->subscribers)
+            {
+                message.sendTo(sub, due[i]->compact.count(sub));
+            }
+        }
     }
 }
 
-QString DataPlugin::craftDataMessage(const DataSource& data)
+DataMessage DataPlugin::craftDataMessage(DataSource& data)
 {
-    QJsonObject reply;
-    auto        dat = reply["data"];
+    quasar_data_t dat;
+    dat.trusted = m_trustedjson;
+    dat.history = m_historywindow > 0 && !data.nonnumeric;
 
     // Poll plugin for data source
     if (!m_plugin->get_data(data.uid, &dat))
     {
         qWarning() << "getData(" << getCode() << ", " << data.key << ") failed";
-        return QString();
+        return DataMessage();
+    }
+
+    return finishDataMessage(data, dat);
+}
+
+DataMessage DataPlugin::finishDataMessage(DataSource& data, const quasar_data_t& dat)
+{
+    DataMessage msg;
+
+    if (!dat.blob.isEmpty())
+    {
+        msg.binary = data.blobheader + dat.blob;
+
+        if (!data.compact.empty())
+        {
+            msg.compactbinary = data.compactblobheader + dat.blob;
+        }
+
+        return msg;
+    }
+
+    if (dat.depth != 0)
+    {
+        qWarning() << "Plugin " << m_code << " left " << dat.depth << " data containers open in source " << data.key;
+        return msg;
+    }
+
+    if (dat.extra)
+    {
+        qWarning() << "Plugin " << m_code << " added more than one top level value in source " << data.key;
+        return msg;
     }
 
-    if (dat.isNull())
+    QByteArray message = "{\"data\":";
+
+    if (!dat.raw.isEmpty())
+    {
+        // Already serialized by the plugin
+        message += dat.raw;
+    }
+    else if (dat.value.isNull() || dat.value.isUndefined())
     {
         // Allow empty return (for async data)
-        return QString();
+        return msg;
+    }
+    else
+    {
+        message += to_json_value(dat.value);
+    }
+
+    recordHistory(data, dat);
+
+    if (!data.compact.empty())
+    {
+        msg.compacttext = QString::fromUtf8(message + data.compactenvelope);
+    }
+
+    message += data.envelope;
+
+    msg.text = QString::fromUtf8(message);
+    return msg;
+}
+
+void DataPlugin::recordHistory(DataSource& data, const quasar_data_t& dat)
+{
+    if (m_historywindow <= 0 || data.nonnumeric)
+    {
+        return;
+    }
+
+    QJsonValue val    = dat.value;
+    bool       fields = false;
+
+    if (!dat.raw.isEmpty())
+    {
+        // Raw is never parsed back: a bare number is read as is, and a flat object
+        // only comes from the members the data builder noted while writing it
+        bool   ok;
+        double d = dat.raw.toDouble(&ok);
+
+        val    = ok ? QJsonValue(d) : QJsonValue();
+        fields = !ok && dat.numeric && !dat.keys.isEmpty();
+    }
+
+    // A source's payloads keep their shape, so once one can't be recorded
+    // the rest are not looked at either
+    if (!fields && !val.isDouble() && !val.isObject())
+    {
+        data.nonnumeric = true;
+        return;
+    }
+
+    if (!data.history)
+    {
+        data.history = std::make_unique<DataHistory>(m_historywindow, data.refreshmsec, m_historymaxbytes);
     }
 
-    // Craft response
-    reply["type"]   = "data";
-    reply["plugin"] = getCode();
-    reply["source"] = data.key;
+    if (!data.store && m_historyretention > 0)
+    {
+        data.store = std::make_unique<HistoryStore>(getHistoryPath(data), m_historyretention);
+    }
 
-    QJsonDocument doc(reply);
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
 
-    return QString::fromUtf8(doc.toJson());
+    if (fields ? !data.history->record(now, dat.keys, dat.numbers) : !data.history->record(now, val))
+    {
+        data.nonnumeric = true;
+        return;
+    }
+
+    if (data.store)
+    {
+        DataHistory& h = *data.history;
+        data.store->append(h.time(h.count() - 1), h.fields(), h.lastValues());
+    }
+}
+
+QString DataPlugin::getHistoryPath(const DataSource& data)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history/" + getCode() + "/" + data.key;
 }
@@ -2,6 +2,7 @@
 
 #include <qstring_hash_impl.h>
 
+#include <historystore.h>
 #include <plugin_types.h>
 
 #include <condition_variable>
@@ -10,21 +11,38 @@
 #include <set>
 #include <unordered_map>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QTimer>
 
 #define QUASAR_DP_ENABLED_PREFIX "enabled_"
 #define QUASAR_DP_REFRESH_PREFIX "refresh_"
 #define QUASAR_DP_CUSTOM_PREFIX "custom_"
+#define QUASAR_DP_TRUSTEDJSON "trustedJson"
 
-#ifdef PLUGINAPI_LIB
-#    define PAPI_EXPORT Q_DECL_EXPORT
-#else
-#    define PAPI_EXPORT Q_DECL_IMPORT
-#endif // PLUGINAPI_LIB
+// First byte of binary data frames, bump when the header layout changes
+#define QUASAR_DP_BLOB_VERSION 1
+
+// First byte of binary data frames addressed by channel id
+#define QUASAR_DP_BLOB_COMPACT_VERSION 2
+
+// First byte of binary history frames
+#define QUASAR_DP_HISTORY_VERSION 3
+
+#ifndef PAPI_EXPORT
+#    ifdef PLUGINAPI_LIB
+#        define PAPI_EXPORT Q_DECL_EXPORT
+#    else
+#        define PAPI_EXPORT Q_DECL_IMPORT
+#    endif // PLUGINAPI_LIB
+#endif
 
 QT_FORWARD_DECLARE_CLASS(QWebSocket)
 
+struct quasar_data_t;
+
+class PluginTasks;
+
 struct DataLock
 {
     std::mutex              mutex;
@@ -32,18 +50,42 @@ struct DataLock
     bool                    processed = false;
 };
 
+// Outbound data message, sent as a text frame or a binary frame.
+// The compact forms carry the same data addressed by channel id and are
+// only built while the source has compact subscribers
+struct DataMessage
+{
+    QString    text;
+    QByteArray binary;
+    QString    compacttext;
+    QByteArray compactbinary;
+
+    bool isEmpty() const { return text.isEmpty() && binary.isEmpty(); }
+    void sendTo(QWebSocket* socket, bool compact = false) const;
+};
+
 struct DataSource
 {
-    bool                      enabled;
-    QString                   key;
-    size_t                    uid;
-    int64_t                   refreshmsec;
-    std::unique_ptr<QTimer>   timer;
-    std::set<QWebSocket*>     subscribers;
-    std::unique_ptr<DataLock> locks;
+    bool                          enabled;
+    QString                       key;
+    size_t                        uid;               // also the channel id on the wire
+    int64_t                       refreshmsec;
+    std::unique_ptr<QTimer>       timer;
+    std::set<QWebSocket*>         subscribers;
+    std::set<QWebSocket*>         suspended;
+    std::set<QWebSocket*>         compact;           // subscribers receiving channel id frames
+    std::unique_ptr<DataLock>     locks;
+    DataMessage                   lastmessage;
+    QByteArray                    envelope;          // message tail following the data payload
+    QByteArray                    blobheader;        // binary frame header preceding blob payloads
+    QByteArray                    compactenvelope;   // envelope of channel id frames
+    QByteArray                    compactblobheader; // blob header of channel id frames
+    std::unique_ptr<DataHistory>  history;           // created on the first numeric value
+    std::unique_ptr<HistoryStore> store;             // on-disk history, if retention is set
+    bool                          nonnumeric;        // sent something history can't record, not parsed again
 };
 
-using DataSourceMapType = std::unordered_map<QString, DataSource>;
+using DataSourceMapType = QStringHashMap<DataSource>;
 
 class PAPI_EXPORT DataPlugin : public QObject
 {
@@ -59,10 +101,18 @@ public:
     static uintmax_t   _uid;
     static DataPlugin* load(QString libpath, QObject* parent = Q_NULLPTR);
 
-    bool addSubscriber(QString source, QWebSocket* subscriber, QString widgetName);
+    bool addSubscriber(QString source, QWebSocket* subscriber, QString widgetName, bool compact = false);
+    bool addSubscriber(DataSource& data, QWebSocket* subscriber, bool compact = false); // true if no other subscriber is active
     void removeSubscriber(QWebSocket* subscriber);
 
+    // Fetches a source the plugin signals for its subscribers, for when the first one arrives
+    void fetchSignaledData(DataSource& data);
+
+    void suspendSubscriber(QWebSocket* subscriber);
+    void resumeSubscriber(QWebSocket* subscriber);
+
     void pollAndSendData(QString source, QWebSocket* subscriber, QString widgetName);
+    void pollAndSendData(DataSource& data, QWebSocket* subscriber);
     void sendDataToSubscribers(DataSource& source);
 
     QString getLibPath() { return m_libpath; };
@@ -74,6 +124,7 @@ public:
     QString getSettingsCode(QString key) { return "plugin_" + getCode() + "/" + key; };
 
     quasar_settings_t* getSettings() { return m_settings.get(); };
+    PluginTasks*       getTasks() { return m_tasks.get(); };
     DataSourceMapType& getDataSources() { return m_datasources; };
 
     void setDataSourceEnabled(QString source, bool enabled);
@@ -85,8 +136,8 @@ public:
 
     void updatePluginSettings();
 
-    void emitDataReady(QString source);
-    void waitDataProcessed(QString source);
+    void emitDataReady(const char* source);
+    void waitDataProcessed(const char* source);
 
 signals:
     void dataReady(QString source);
@@ -98,12 +149,22 @@ private:
     DataPlugin(quasar_plugin_info_t* p, plugin_destroy destroyfunc, QString path, QObject* parent = Q_NULLPTR);
 
     void    createTimer(DataSource& data);
-    QString craftDataMessage(const DataSource& data);
+    bool    keepsSampling(const DataSource& data) const; // fetched without subscribers to fill its history
+    void    broadcastData(DataSource& data);
+    DataMessage craftDataMessage(DataSource& data);
+    DataMessage finishDataMessage(DataSource& data, const quasar_data_t& dat);
+    void        recordHistory(DataSource& data, const quasar_data_t& dat);
+    QString     getHistoryPath(const DataSource& data);
+
+    bool hasBatchSupport();
+    void queueDueSource(DataSource& data);
+    void sendDueSources();
 
     quasar_plugin_info_t* m_plugin;
     plugin_destroy        m_destroyfunc;
 
     std::unique_ptr<quasar_settings_t> m_settings;
+    std::unique_ptr<PluginTasks>       m_tasks;
 
     QString m_libpath;
     QString m_name;
@@ -113,4 +174,16 @@ private:
     QString m_version;
 
     DataSourceMapType m_datasources;
+
+    // Raw JSON from this plugin is sent without validation
+    bool m_trustedjson = false;
+
+    // History kept per numeric source, disabled with a zero window
+    qint64 m_historywindow    = 0;
+    size_t m_historymaxbytes  = 0;
+    qint64 m_historyretention = 0;
+
+    // Timed sources that came due in the same tick, fetched with one get_data_batch call
+    std::vector<DataSource*> m_duesources;
+    QElapsedTimer            m_epoch;
 };
@@ -0,0 +1,452 @@
+#include "historystore.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // Start of every segment file, the field names follow it as '\n' separated UTF-8
+    struct SegmentHeader
+    {
+        char     magic[4];
+        uint32_t columns;
+        uint32_t capacity; // records
+        uint32_t namesize;
+        uint64_t count; // records written, bumped once a record is complete
+    };
+
+    const char   SEGMENT_MAGIC[4]    = { 'Q', 'T', 'S', '1' };
+    const qint64 SEGMENT_HEADER_SIZE = 1024;
+
+    SegmentHeader* header(uchar* map)
+    {
+        return reinterpret_cast<SegmentHeader*>(map);
+    }
+
+    // Zero padded so that name order is time order
+    QString segment_name(qint64 msec)
+    {
+        return QString("%1.qts").arg(msec, 16, 10, QChar('0'));
+    }
+
+    // One thread does the file work of every store, in order
+    struct StorePool : public QThreadPool
+    {
+        StorePool() { setMaxThreadCount(1); }
+    };
+
+    QThreadPool* store_pool()
+    {
+        static StorePool pool;
+        return &pool;
+    }
+
+    template <typename Fn>
+    class StoreJob : public QRunnable
+    {
+    public:
+        explicit StoreJob(Fn&& fn)
+            : m_fn(std::move(fn)) {}
+
+        void run() override { m_fn(); }
+
+    private:
+        Fn m_fn;
+    };
+
+    template <typename Fn>
+    void run_in_background(Fn fn)
+    {
+        store_pool()->start(new StoreJob<Fn>(std::move(fn)));
+    }
+}
+
+HistoryStore::HistoryStore(QString path, qint64 retentionMsec)
+    : m_path(path), m_retention(retentionMsec), m_spare(std::make_shared<Spare>())
+{
+    QDir dir(m_path);
+
+    if (!dir.mkpath("."))
+    {
+        qWarning() << "Failed to create history store" << m_path;
+        return;
+    }
+
+    QStringList files = dir.entryList(QStringList() << "*.qts", QDir::Files, QDir::Name);
+
+    for (const QString& f : files)
+    {
+        if (!openSegment(dir.filePath(f)))
+        {
+            qWarning() << "Discarding unreadable history segment" << dir.filePath(f);
+            QFile::remove(dir.filePath(f));
+        }
+    }
+
+    retire(QDateTime::currentMSecsSinceEpoch());
+}
+
+HistoryStore::~HistoryStore()
+{
+    for (Segment& seg : m_segments)
+    {
+        seg.file->unmap(seg.map);
+    }
+
+    // A spare left behind is an empty segment, the next run appends to it
+}
+
+bool HistoryStore::openSegment(const QString& filename)
+{
+    auto file = std::make_unique<QFile>(filename);
+
+    if (!file->open(QIODevice::ReadWrite) || file->size() < SEGMENT_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    uchar* map = file->map(0, file->size());
+
+    if (!map)
+    {
+        return false;
+    }
+
+    SegmentHeader* hdr = header(map);
+
+    if (std::memcmp(hdr->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 || hdr->columns == 0 ||
+        hdr->namesize > SEGMENT_HEADER_SIZE - sizeof(SegmentHeader))
+    {
+        return false;
+    }
+
+    size_t recordsize = sizeof(qint64) + sizeof(double) * hdr->columns;
+
+    if (file->size() < SEGMENT_HEADER_SIZE + (qint64) (hdr->capacity * recordsize))
+    {
+        return false;
+    }
+
+    QStringList fields = QString::fromUtf8((const char*) map + sizeof(SegmentHeader), hdr->namesize).split('\n');
+
+    if (fields.size() != (int) hdr->columns)
+    {
+        return false;
+    }
+
+    // Columns changed between runs, older segments no longer fit
+    if (fields != m_fields)
+    {
+        removeSegments(m_segments.size());
+
+        m_fields     = fields;
+        m_recordsize = recordsize;
+    }
+
+    m_segments.push_back({ std::move(file), map, m_count });
+    m_count += segmentCount(m_segments.back());
+
+    m_lastname = std::max(m_lastname, QFileInfo(filename).baseName().toLongLong());
+
+    return true;
+}
+
+bool HistoryStore::createSegment(const QString& path, qint64 name, const QStringList& fields, Segment& seg)
+{
+    QByteArray names      = fields.join('\n').toUtf8();
+    size_t     recordsize = sizeof(qint64) + sizeof(double) * fields.size();
+
+    if (names.size() > SEGMENT_HEADER_SIZE - (qint64) sizeof(SegmentHeader))
+    {
+        qWarning() << "Too many history fields to store in" << path;
+        return false;
+    }
+
+    QDir dir(path);
+
+    while (dir.exists(segment_name(name)))
+    {
+        name++;
+    }
+
+    auto   file = std::make_unique<QFile>(dir.filePath(segment_name(name)));
+    qint64 size = SEGMENT_HEADER_SIZE + (qint64) (QUASAR_STORE_SEGMENT_RECORDS * recordsize);
+
+    if (!file->open(QIODevice::ReadWrite) || !file->resize(size))
+    {
+        qWarning() << "Failed to create history segment" << file->fileName() << file->errorString();
+        return false;
+    }
+
+    uchar* map = file->map(0, size);
+
+    if (!map)
+    {
+        qWarning() << "Failed to map history segment" << file->fileName() << file->errorString();
+        return false;
+    }
+
+    SegmentHeader* hdr = header(map);
+
+    std::memcpy(hdr->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    hdr->columns  = fields.size();
+    hdr->capacity = QUASAR_STORE_SEGMENT_RECORDS;
+    hdr->namesize = names.size();
+    hdr->count    = 0;
+
+    std::memcpy(map + sizeof(SegmentHeader), names.constData(), names.size());
+
+    seg.file = std::move(file);
+    seg.map  = map;
+
+    return true;
+}
+
+void HistoryStore::deleteSegments(std::vector<Segment> segments)
+{
+    if (segments.empty())
+    {
+        return;
+    }
+
+    auto shared = std::make_shared<std::vector<Segment>>(std::move(segments));
+
+    run_in_background([shared] {
+        for (Segment& seg : *shared)
+        {
+            QString path = seg.file->fileName();
+
+            seg.file->unmap(seg.map);
+            seg.file->close();
+
+            QFile::remove(path);
+        }
+    });
+}
+
+qint64 HistoryStore::nextName(qint64 msec)
+{
+    m_lastname = std::max(msec, m_lastname + 1);
+    return m_lastname;
+}
+
+bool HistoryStore::startSegment(qint64 msec)
+{
+    Segment seg;
+    bool    spare = false;
+
+    {
+        std::lock_guard<std::mutex> lk(m_spare->mutex);
+
+        if (m_spare->segment.file)
+        {
+            if (m_spare->fields == m_fields)
+            {
+                seg   = std::move(m_spare->segment);
+                spare = true;
+            }
+            else
+            {
+                std::vector<Segment> stale;
+                stale.push_back(std::move(m_spare->segment));
+                deleteSegments(std::move(stale));
+            }
+
+            m_spare->segment = Segment();
+        }
+    }
+
+    // Only the first segment, or one after the columns changed, is created in line
+    if (!spare && !createSegment(m_path, nextName(msec), m_fields, seg))
+    {
+        return false;
+    }
+
+    seg.first = m_count;
+    m_segments.push_back(std::move(seg));
+
+    prepareSpare();
+    retire(msec);
+
+    return true;
+}
+
+void HistoryStore::prepareSpare()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_spare->mutex);
+
+        if (m_spare->pending)
+        {
+            return;
+        }
+
+        m_spare->pending = true;
+    }
+
+    std::shared_ptr<Spare> spare  = m_spare;
+    QString                path   = m_path;
+    QStringList            fields = m_fields;
+    qint64                 name   = nextName(QDateTime::currentMSecsSinceEpoch());
+
+    run_in_background([spare, path, fields, name] {
+        Segment seg;
+        bool    ok = createSegment(path, name, fields, seg);
+
+        std::vector<Segment> stale;
+
+        {
+            std::lock_guard<std::mutex> lk(spare->mutex);
+
+            if (spare->segment.file)
+            {
+                stale.push_back(std::move(spare->segment));
+            }
+
+            spare->segment = ok ? std::move(seg) : Segment();
+            spare->fields  = fields;
+            spare->pending = false;
+        }
+
+        deleteSegments(std::move(stale));
+    });
+}
+
+void HistoryStore::removeSegments(size_t count)
+{
+    std::vector<Segment> removed(std::make_move_iterator(m_segments.begin()), std::make_move_iterator(m_segments.begin() + count));
+
+    m_segments.erase(m_segments.begin(), m_segments.begin() + count);
+
+    // Unmapping and deleting happens off the caller's thread
+    deleteSegments(std::move(removed));
+
+    // Renumber what is left
+    m_count = 0;
+
+    for (Segment& seg : m_segments)
+    {
+        seg.first = m_count;
+        m_count += segmentCount(seg);
+    }
+}
+
+void HistoryStore::retire(qint64 msec)
+{
+    size_t expired = 0;
+
+    // The newest segment is kept, it is the one being appended to
+    while (expired + 1 < m_segments.size())
+    {
+        const Segment& seg = m_segments[expired];
+        size_t         n   = segmentCount(seg);
+
+        if (n && time(seg.first + n - 1) >= msec - m_retention)
+        {
+            break;
+        }
+
+        expired++;
+    }
+
+    if (expired)
+    {
+        removeSegments(expired);
+    }
+}
+
+void HistoryStore::append(qint64 msec, const QStringList& fields, const double* values)
+{
+    if (fields != m_fields)
+    {
+        // Columns changed, older records no longer fit
+        removeSegments(m_segments.size());
+
+        m_fields     = fields;
+        m_recordsize = sizeof(qint64) + sizeof(double) * fields.size();
+    }
+
+    if (m_count && msec < time(m_count - 1))
+    {
+        msec = time(m_count - 1);
+    }
+
+    if (m_segments.empty() || segmentCount(m_segments.back()) >= header(m_segments.back().map)->capacity)
+    {
+        if (!startSegment(msec))
+        {
+            return;
+        }
+    }
+
+    SegmentHeader* hdr = header(m_segments.back().map);
+    uchar*         rec = m_segments.back().map + SEGMENT_HEADER_SIZE + hdr->count * m_recordsize;
+
+    std::memcpy(rec, &msec, sizeof(qint64));
+    std::memcpy(rec + sizeof(qint64), values, sizeof(double) * m_fields.size());
+
+    hdr->count++;
+    m_count++;
+}
+
+size_t HistoryStore::segmentCount(const Segment& seg) const
+{
+    const SegmentHeader* hdr = header(seg.map);
+
+    return std::min<uint64_t>(hdr->count, hdr->capacity);
+}
+
+const uchar* HistoryStore::record(size_t i) const
+{
+    // Last segment starting at or before i
+    auto it = std::upper_bound(m_segments.begin(), m_segments.end(), i, [](size_t idx, const Segment& seg) {
+        return idx < seg.first;
+    });
+
+    const Segment& seg = *(it - 1);
+
+    return seg.map + SEGMENT_HEADER_SIZE + (i - seg.first) * m_recordsize;
+}
+
+void HistoryStore::copyRecords(size_t first, size_t count, char* out) const
+{
+    // Records are contiguous within a segment, one copy per segment
+    while (count > 0)
+    {
+        auto it = std::upper_bound(m_segments.begin(), m_segments.end(), first, [](size_t idx, const Segment& seg) {
+            return idx < seg.first;
+        });
+
+        const Segment& seg = *(it - 1);
+        size_t         n   = std::min(count, seg.first + segmentCount(seg) - first);
+
+        std::memcpy(out, seg.map + SEGMENT_HEADER_SIZE + (first - seg.first) * m_recordsize, n * m_recordsize);
+
+        out += n * m_recordsize;
+        first += n;
+        count -= n;
+    }
+}
+
+qint64 HistoryStore::time(size_t i) const
+{
+    qint64 msec;
+    std::memcpy(&msec, record(i), sizeof(msec));
+    return msec;
+}
+
+double HistoryStore::value(size_t i, size_t column) const
+{
+    double val;
+    std::memcpy(&val, record(i) + sizeof(qint64) + sizeof(double) * column, sizeof(val));
+    return val;
+}
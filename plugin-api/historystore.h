@@ -0,0 +1,84 @@
+#pragma once
+
+#include "datahistory.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+// Days of history kept on disk, 0 disables the persistent store
+#define QUASAR_CONFIG_HISTORYRETENTION "global/historyRetention"
+
+// Records per segment file
+#define QUASAR_STORE_SEGMENT_RECORDS 65536
+
+// Persistent history of one data source in append-only, memory-mapped segment files.
+// A segment is a fixed header followed by fixed-width [qint64 msec][double x columns]
+// records in time order. Segment files are named by their creation time, so name order
+// is time order, and a range seek binary searches records straight from the mapping.
+// Segments whose newest record is older than the retention are deleted.
+// The next segment is created and mapped ahead of time, and retired segments are
+// unmapped and deleted, on a background thread, so appends only copy into memory
+class PAPI_EXPORT HistoryStore : public HistoryView
+{
+public:
+    ~HistoryStore();
+    HistoryStore(QString path, qint64 retentionMsec);
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    void append(qint64 msec, const QStringList& fields, const double* values);
+
+    const QStringList& fields() const override { return m_fields; }
+
+    size_t count() const override { return m_count; }
+    qint64 time(size_t i) const override;
+    double value(size_t i, size_t column) const override;
+
+protected:
+    void copyRecords(size_t first, size_t count, char* out) const override;
+
+private:
+    struct Segment
+    {
+        std::unique_ptr<QFile> file;
+        uchar*                 map   = nullptr;
+        size_t                 first = 0; // index of the segment's first record in the store
+    };
+
+    // The next segment, handed over from the background thread
+    struct Spare
+    {
+        std::mutex  mutex;
+        Segment     segment; // no file until created
+        QStringList fields;  // the segment was created for
+        bool        pending = false;
+    };
+
+    static bool createSegment(const QString& path, qint64 name, const QStringList& fields, Segment& seg);
+    static void deleteSegments(std::vector<Segment> segments);
+
+    bool         openSegment(const QString& filename);
+    bool         startSegment(qint64 msec);
+    void         prepareSpare();
+    qint64       nextName(qint64 msec);
+    void         removeSegments(size_t count);
+    void         retire(qint64 msec);
+    const uchar* record(size_t i) const;
+    size_t       segmentCount(const Segment& seg) const;
+
+    QString m_path;
+    qint64  m_retention;
+
+    QStringList            m_fields;
+    size_t                 m_recordsize = 0;
+    std::vector<Segment>   m_segments;
+    size_t                 m_count    = 0;
+    qint64                 m_lastname = 0; // newest segment file name in use
+    std::shared_ptr<Spare> m_spare;
+};
@@ -2,6 +2,7 @@
 #include "plugin_support_internal.h"
 
 #include "dataplugin.h"
+#include "plugintasks.h"
 
 #include <QDebug>
 #include <QJsonArray>
@@ -9,23 +10,228 @@
 #include <QJsonObject>
 #include <QJsonValue>
 
+#include <QLocale>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Single pass structural check of a JSON text: brackets balance and
+    // nest properly, strings terminate, and there is exactly one top level value.
+    // Literals and numbers are not checked
+    bool check_json_structure(const char* data, size_t len)
+    {
+        std::vector<char> stack;
+        bool              instring = false;
+        bool              escape   = false;
+        bool              done     = false;
+        bool              scalar   = false;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            char c = data[i];
+
+            if (instring)
+            {
+                if (escape)
+                    escape = false;
+                else if (c == '\\')
+                    escape = true;
+                else if (c == '"')
+                {
+                    instring = false;
+                    done     = stack.empty();
+                }
+                else if ((unsigned char) c < 0x20)
+                    return false;
+
+                continue;
+            }
+
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                if (stack.empty() && scalar)
+                {
+                    done = true;
+                }
+
+                continue;
+            }
+
+            if (done)
+            {
+                // trailing garbage after the top level value
+                return false;
+            }
+
+            switch (c)
+            {
+                case '"':
+                    instring = true;
+                    break;
+
+                case '{':
+                    stack.push_back('}');
+                    break;
+
+                case '[':
+                    stack.push_back(']');
+                    break;
+
+                case '}':
+                case ']':
+                    if (stack.empty() || stack.back() != c)
+                        return false;
+
+                    stack.pop_back();
+                    break;
+
+                default:
+                    break;
+            }
+
+            if (stack.empty())
+            {
+                // a closing bracket ends the value, strings end at their closing quote
+                if (c == '}' || c == ']')
+                    done = true;
+                else if (c != '"')
+                    scalar = true;
+            }
+        }
+
+        return !instring && stack.empty() && (done || scalar);
+    }
+
+    void append_json_string(QByteArray& out, const char* str)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        out.append('"');
+
+        for (const char* p = str; *p; p++)
+        {
+            unsigned char c = (unsigned char) *p;
+
+            switch (c)
+            {
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                default:
+                    if (c < 0x20)
+                    {
+                        out.append("\\u00");
+                        out.append(hex[c >> 4]);
+                        out.append(hex[c & 0xf]);
+                    }
+                    else
+                    {
+                        out.append((char) c);
+                    }
+                    break;
+            }
+        }
+
+        out.append('"');
+    }
+
+    // Separator and key ahead of a new value. number is the value if it is a finite number
+    quasar_data_t* begin_value(quasar_data_handle hData, const char* key, const double* number = nullptr)
+    {
+        quasar_data_t* ref = (quasar_data_t*) hData;
+
+        if (!ref)
+        {
+            return nullptr;
+        }
+
+        // Only one top level value, a second would be appended after a comma
+        if (ref->depth == 0 && !ref->raw.isEmpty())
+        {
+            ref->extra = true;
+            return nullptr;
+        }
+
+        if (ref->depth == 1 && ref->numeric)
+        {
+            if (key && number)
+            {
+                ref->keys << QString::fromUtf8(key);
+                ref->numbers.push_back(*number);
+            }
+            else
+            {
+                ref->numeric = false;
+            }
+        }
+
+        if (!ref->raw.isEmpty())
+        {
+            char last = ref->raw.at(ref->raw.size() - 1);
+
+            if (last != '{' && last != '[')
+            {
+                ref->raw.append(',');
+            }
+        }
+
+        if (key)
+        {
+            append_json_string(ref->raw, key);
+            ref->raw.append(':');
+        }
+
+        return ref;
+    }
+
+    quasar_data_handle end_container(quasar_data_handle hData, char close)
+    {
+        quasar_data_t* ref = (quasar_data_t*) hData;
+
+        if (!ref || ref->depth == 0)
+        {
+            return nullptr;
+        }
+
+        ref->raw.append(close);
+        ref->depth--;
+
+        return ref;
+    }
+}
+
 void quasar_log(quasar_log_level_t level, const char* msg)
 {
     QString lg = QString::fromUtf8(msg);
     switch (level)
     {
         case QUASAR_LOG_DEBUG:
-            qDebug() << lg;
+            qDebug().noquote() << lg;
             break;
         case QUASAR_LOG_INFO:
         default:
-            qInfo() << lg;
+            qInfo().noquote() << lg;
             break;
         case QUASAR_LOG_WARNING:
-            qWarning() << lg;
+            qWarning().noquote() << lg;
             break;
         case QUASAR_LOG_CRITICAL:
-            qCritical() << lg;
+            qCritical().noquote() << lg;
             break;
     }
 }
@@ -37,11 +243,11 @@ quasar_settings_t* quasar_create_settings(void)
 
 quasar_data_handle quasar_set_data_string(quasar_data_handle hData, const char* data)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
-        (*ref) = QString::fromUtf8(data);
+        ref->value = QString::fromUtf8(data);
 
         return ref;
     }
@@ -51,12 +257,32 @@ quasar_data_handle quasar_set_data_string(quasar_data_handle hData, const char*
 
 quasar_data_handle quasar_set_data_json(quasar_data_handle hData, const char* data)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
-        QString str = QString::fromUtf8(data);
-        (*ref)      = QJsonDocument::fromJson(str.toUtf8()).object();
+        ref->value = QJsonDocument::fromJson(QByteArray::fromRawData(data, (int) strlen(data))).object();
+
+        return ref;
+    }
+
+    return nullptr;
+}
+
+quasar_data_handle quasar_set_data_raw_json(quasar_data_handle hData, const char* data, size_t len)
+{
+    quasar_data_t* ref = (quasar_data_t*) hData;
+
+    if (ref && data && len > 0)
+    {
+        if (!ref->trusted && !check_json_structure(data, len))
+        {
+            qWarning() << "Rejected malformed raw JSON data";
+            return nullptr;
+        }
+
+        ref->raw     = QByteArray(data, (int) len);
+        ref->numeric = false;
 
         return ref;
     }
@@ -66,11 +292,11 @@ quasar_data_handle quasar_set_data_json(quasar_data_handle hData, const char* da
 
 quasar_data_handle quasar_set_data_binary(quasar_data_handle hData, const char* data, size_t len)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
-        (*ref) = QJsonDocument::fromRawData(data, len).object();
+        ref->value = QJsonDocument::fromRawData(data, len).object();
 
         return ref;
     }
@@ -78,9 +304,120 @@ quasar_data_handle quasar_set_data_binary(quasar_data_handle hData, const char*
     return nullptr;
 }
 
+quasar_data_handle quasar_set_data_blob(quasar_data_handle hData, const void* data, size_t len)
+{
+    quasar_data_t* ref = (quasar_data_t*) hData;
+
+    if (ref && data && len > 0)
+    {
+        ref->blob = QByteArray((const char*) data, (int) len);
+
+        return ref;
+    }
+
+    return nullptr;
+}
+
+quasar_data_handle quasar_data_begin_object(quasar_data_handle hData, const char* key)
+{
+    quasar_data_t* ref = begin_value(hData, key);
+
+    if (ref)
+    {
+        if (ref->depth == 0)
+        {
+            ref->numeric = ref->history;
+        }
+
+        ref->raw.append('{');
+        ref->depth++;
+    }
+
+    return ref;
+}
+
+quasar_data_handle quasar_data_end_object(quasar_data_handle hData)
+{
+    return end_container(hData, '}');
+}
+
+quasar_data_handle quasar_data_begin_array(quasar_data_handle hData, const char* key)
+{
+    quasar_data_t* ref = begin_value(hData, key);
+
+    if (ref)
+    {
+        ref->raw.append('[');
+        ref->depth++;
+    }
+
+    return ref;
+}
+
+quasar_data_handle quasar_data_end_array(quasar_data_handle hData)
+{
+    return end_container(hData, ']');
+}
+
+quasar_data_handle quasar_data_add_int(quasar_data_handle hData, const char* key, intmax_t val)
+{
+    double         number = (double) val;
+    quasar_data_t* ref    = begin_value(hData, key, &number);
+
+    if (ref)
+    {
+        ref->raw.append(QByteArray::number((qlonglong) val));
+    }
+
+    return ref;
+}
+
+quasar_data_handle quasar_data_add_double(quasar_data_handle hData, const char* key, double val)
+{
+    quasar_data_t* ref = begin_value(hData, key, std::isfinite(val) ? &val : nullptr);
+
+    if (ref)
+    {
+        // JSON has no representation for nan or inf
+        if (std::isfinite(val))
+            ref->raw.append(QByteArray::number(val, 'g', QLocale::FloatingPointShortest));
+        else
+            ref->raw.append("null");
+    }
+
+    return ref;
+}
+
+quasar_data_handle quasar_data_add_string(quasar_data_handle hData, const char* key, const char* val)
+{
+    quasar_data_t* ref = begin_value(hData, key);
+
+    if (ref)
+    {
+        if (val)
+            append_json_string(ref->raw, val);
+        else
+            ref->raw.append("null");
+    }
+
+    return ref;
+}
+
+quasar_data_handle quasar_data_add_bool(quasar_data_handle hData, const char* key, bool val)
+{
+    quasar_data_t* ref = begin_value(hData, key);
+
+    if (ref)
+    {
+        ref->raw.append(val ? "true" : "false");
+    }
+
+    return ref;
+}
+
 quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char** arr, size_t len)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
@@ -91,7 +428,7 @@ quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char**
             jarr.append(QString(arr[i]));
         }
 
-        (*ref) = jarr;
+        ref->value = jarr;
 
         return ref;
     }
@@ -101,7 +438,7 @@ quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char**
 
 quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr, size_t len)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
@@ -112,7 +449,7 @@ quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr,
             jarr.append(arr[i]);
         }
 
-        (*ref) = jarr;
+        ref->value = jarr;
 
         return ref;
     }
@@ -122,7 +459,7 @@ quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr,
 
 quasar_data_handle quasar_set_data_float_array(quasar_data_handle hData, float* arr, size_t len)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
@@ -133,7 +470,7 @@ quasar_data_handle quasar_set_data_float_array(quasar_data_handle hData, float*
             jarr.append((double) arr[i]);
         }
 
-        (*ref) = jarr;
+        ref->value = jarr;
 
         return ref;
     }
@@ -143,7 +480,7 @@ quasar_data_handle quasar_set_data_float_array(quasar_data_handle hData, float*
 
 quasar_data_handle quasar_set_data_double_array(quasar_data_handle hData, double* arr, size_t len)
 {
-    QJsonValueRef* ref = (QJsonValueRef*) hData;
+    quasar_data_t* ref = (quasar_data_t*) hData;
 
     if (ref)
     {
@@ -154,7 +491,7 @@ quasar_data_handle quasar_set_data_double_array(quasar_data_handle hData, double
             jarr.append(arr[i]);
         }
 
-        (*ref) = jarr;
+        ref->value = jarr;
 
         return ref;
     }
@@ -162,6 +499,75 @@ quasar_data_handle quasar_set_data_double_array(quasar_data_handle hData, double
     return nullptr;
 }
 
+namespace
+{
+    void add_setting(quasar_settings_t* settings, const char* name, quasar_setting_def_t& entry)
+    {
+        entry.index = settings->values.size();
+
+        if (settings->map.insert(std::make_pair(name, entry)).second)
+        {
+            settings->values.emplace_back(quasar_encode_setting(entry));
+        }
+    }
+
+    const std::atomic<uint64_t>* find_setting(quasar_settings_t* settings, const char* name)
+    {
+        if (settings)
+        {
+            auto it = settings->map.find(name);
+
+            if (it != settings->map.end())
+            {
+                return &settings->values[it->second.index];
+            }
+        }
+
+        return nullptr;
+    }
+
+    const std::atomic<uint64_t>* find_setting(quasar_settings_t* settings, quasar_setting_handle setting)
+    {
+        if (settings && setting >= 0 && static_cast<size_t>(setting) < settings->values.size())
+        {
+            return &settings->values[setting];
+        }
+
+        return nullptr;
+    }
+
+    template<typename T>
+    T decode_setting(const std::atomic<uint64_t>* slot)
+    {
+        if (!slot)
+        {
+            return T();
+        }
+
+        return static_cast<T>(static_cast<int64_t>(slot->load(std::memory_order_acquire)));
+    }
+
+    template<>
+    bool decode_setting<bool>(const std::atomic<uint64_t>* slot)
+    {
+        return slot && slot->load(std::memory_order_acquire) != 0;
+    }
+
+    template<>
+    double decode_setting<double>(const std::atomic<uint64_t>* slot)
+    {
+        if (!slot)
+        {
+            return 0.0;
+        }
+
+        uint64_t bits = slot->load(std::memory_order_acquire);
+        double   val;
+        std::memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+} // namespace
+
 quasar_settings_t* quasar_add_int(quasar_settings_t* settings, const char* name, const char* description, int min, int max, int step, int dflt)
 {
     if (settings)
@@ -175,7 +581,7 @@ quasar_settings_t* quasar_add_int(quasar_settings_t* settings, const char* name,
         entry.inttype.step = step;
         entry.inttype.def = entry.inttype.val = dflt;
 
-        settings->map.insert(std::make_pair(name, entry));
+        add_setting(settings, name, entry);
 
         return settings;
     }
@@ -193,7 +599,7 @@ quasar_settings_t* quasar_add_bool(quasar_settings_t* settings, const char* name
         entry.description  = description;
         entry.booltype.def = entry.booltype.val = dflt;
 
-        settings->map.insert(std::make_pair(name, entry));
+        add_setting(settings, name, entry);
 
         return settings;
     }
@@ -214,7 +620,7 @@ quasar_settings_t* quasar_add_double(quasar_settings_t* settings, const char* na
         entry.doubletype.step = step;
         entry.doubletype.def = entry.doubletype.val = dflt;
 
-        settings->map.insert(std::make_pair(name, entry));
+        add_setting(settings, name, entry);
 
         return settings;
     }
@@ -224,42 +630,62 @@ quasar_settings_t* quasar_add_double(quasar_settings_t* settings, const char* na
 
 intmax_t quasar_get_int(quasar_settings_t* settings, const char* name)
 {
-    if (settings && settings->map.count(name))
-    {
-        return settings->map[name].inttype.val;
-    }
-
-    return intmax_t();
+    return decode_setting<intmax_t>(find_setting(settings, name));
 }
 
 uintmax_t quasar_get_uint(quasar_settings_t* settings, const char* name)
 {
-    if (settings && settings->map.count(name))
-    {
-        return settings->map[name].inttype.val;
-    }
-
-    return uintmax_t();
+    return decode_setting<uintmax_t>(find_setting(settings, name));
 }
 
 bool quasar_get_bool(quasar_settings_t* settings, const char* name)
 {
-    if (settings && settings->map.count(name))
-    {
-        return settings->map[name].booltype.val;
-    }
-
-    return false;
+    return decode_setting<bool>(find_setting(settings, name));
 }
 
 double quasar_get_double(quasar_settings_t* settings, const char* name)
 {
-    if (settings && settings->map.count(name))
+    return decode_setting<double>(find_setting(settings, name));
+}
+
+quasar_setting_handle quasar_get_setting_handle(quasar_settings_t* settings, const char* name)
+{
+    if (settings && name)
     {
-        return settings->map[name].doubletype.val;
+        auto it = settings->map.find(name);
+
+        if (it != settings->map.end())
+        {
+            return static_cast<quasar_setting_handle>(it->second.index);
+        }
     }
 
-    return 0.0;
+    return QUASAR_INVALID_SETTING_HANDLE;
+}
+
+intmax_t quasar_get_setting_int(quasar_settings_t* settings, quasar_setting_handle setting)
+{
+    return decode_setting<intmax_t>(find_setting(settings, setting));
+}
+
+uintmax_t quasar_get_setting_uint(quasar_settings_t* settings, quasar_setting_handle setting)
+{
+    return decode_setting<uintmax_t>(find_setting(settings, setting));
+}
+
+bool quasar_get_setting_bool(quasar_settings_t* settings, quasar_setting_handle setting)
+{
+    return decode_setting<bool>(find_setting(settings, setting));
+}
+
+double quasar_get_setting_double(quasar_settings_t* settings, quasar_setting_handle setting)
+{
+    return decode_setting<double>(find_setting(settings, setting));
+}
+
+uint32_t quasar_get_settings_version(quasar_settings_t* settings)
+{
+    return settings ? settings->version.load(std::memory_order_acquire) : 0;
 }
 
 void quasar_signal_data_ready(quasar_plugin_handle handle, const char* source)
@@ -281,3 +707,82 @@ void quasar_signal_wait_processed(quasar_plugin_handle handle, const char* sourc
         plugin->waitDataProcessed(source);
     }
 }
+
+namespace
+{
+    quasar_task_handle run_task(quasar_plugin_handle handle, quasar_task_t::TaskKind kind, quasar_task_call_t fn, void* userdata, uint32_t intervalMsec, int flags)
+    {
+        DataPlugin* plugin = (DataPlugin*) handle;
+
+        if (plugin)
+        {
+            return plugin->getTasks()->run(kind, fn, userdata, intervalMsec, flags);
+        }
+
+        return nullptr;
+    }
+}
+
+quasar_task_handle quasar_task_run(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, int flags)
+{
+    return run_task(handle, quasar_task_t::TASK_ONESHOT, fn, userdata, 0, flags);
+}
+
+quasar_task_handle quasar_task_run_periodic(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, uint32_t intervalMsec, int flags)
+{
+    return run_task(handle, quasar_task_t::TASK_PERIODIC, fn, userdata, intervalMsec, flags);
+}
+
+quasar_task_handle quasar_task_run_loop(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, int flags)
+{
+    return run_task(handle, quasar_task_t::TASK_LOOP, fn, userdata, 0, flags);
+}
+
+void quasar_task_cancel(quasar_task_handle task)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    if (t)
+    {
+        t->owner->cancel(t);
+    }
+}
+
+bool quasar_task_is_cancelled(quasar_task_handle task)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    return !t || t->cancelled;
+}
+
+bool quasar_task_wait_cancelled(quasar_task_handle task, uint32_t msec)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    if (t)
+    {
+        return t->owner->waitCancelled(t, msec);
+    }
+
+    return true;
+}
+
+void quasar_task_wait(quasar_task_handle task)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    if (t)
+    {
+        t->owner->wait(t);
+    }
+}
+
+void quasar_task_release(quasar_task_handle task)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    if (t)
+    {
+        t->owner->release(t);
+    }
+}
@@ -22,7 +22,27 @@ SAPI_EXPORT quasar_settings_t* quasar_create_settings(void);
 
 SAPI_EXPORT quasar_data_handle quasar_set_data_string(quasar_data_handle hData, const char* data);
 SAPI_EXPORT quasar_data_handle quasar_set_data_json(quasar_data_handle hData, const char* data);
+SAPI_EXPORT quasar_data_handle quasar_set_data_raw_json(quasar_data_handle hData, const char* data, size_t len);
 SAPI_EXPORT quasar_data_handle quasar_set_data_binary(quasar_data_handle hData, const char* data, size_t len);
+SAPI_EXPORT quasar_data_handle quasar_set_data_blob(quasar_data_handle hData, const void* data, size_t len);
+
+// Data builder
+//
+// Writes structured data straight into the outbound message, i.e.
+//   quasar_data_begin_object(hData, NULL);
+//   quasar_data_add_int(hData, "total", total);
+//   quasar_data_end_object(hData);
+//
+// key must be NULL for array elements and the top level value. There is only one
+// top level value: adding another returns NULL and the data is not sent
+SAPI_EXPORT quasar_data_handle quasar_data_begin_object(quasar_data_handle hData, const char* key);
+SAPI_EXPORT quasar_data_handle quasar_data_end_object(quasar_data_handle hData);
+SAPI_EXPORT quasar_data_handle quasar_data_begin_array(quasar_data_handle hData, const char* key);
+SAPI_EXPORT quasar_data_handle quasar_data_end_array(quasar_data_handle hData);
+SAPI_EXPORT quasar_data_handle quasar_data_add_int(quasar_data_handle hData, const char* key, intmax_t val);
+SAPI_EXPORT quasar_data_handle quasar_data_add_double(quasar_data_handle hData, const char* key, double val);
+SAPI_EXPORT quasar_data_handle quasar_data_add_string(quasar_data_handle hData, const char* key, const char* val);
+SAPI_EXPORT quasar_data_handle quasar_data_add_bool(quasar_data_handle hData, const char* key, bool val);
 
 SAPI_EXPORT quasar_data_handle quasar_set_data_string_array(quasar_data_handle hData, char** arr, size_t len);
 SAPI_EXPORT quasar_data_handle quasar_set_data_int_array(quasar_data_handle hData, int* arr, size_t len);
@@ -38,9 +58,52 @@ SAPI_EXPORT uintmax_t quasar_get_uint(quasar_settings_t* settings, const char* n
 SAPI_EXPORT bool      quasar_get_bool(quasar_settings_t* settings, const char* name);
 SAPI_EXPORT double    quasar_get_double(quasar_settings_t* settings, const char* name);
 
+// Handle-based setting access
+//
+// Reads are lock-free and allocation-free, and safe from any plugin thread.
+// Resolve handles once, i.e. in init(), then read them in hot paths.
+// The settings version is odd while an update is being published and
+// changes after each one, so a consistent set of values can be read with
+//   do { v = quasar_get_settings_version(s); ... } while ((v & 1) || v != quasar_get_settings_version(s));
+SAPI_EXPORT quasar_setting_handle quasar_get_setting_handle(quasar_settings_t* settings, const char* name);
+SAPI_EXPORT intmax_t              quasar_get_setting_int(quasar_settings_t* settings, quasar_setting_handle setting);
+SAPI_EXPORT uintmax_t             quasar_get_setting_uint(quasar_settings_t* settings, quasar_setting_handle setting);
+SAPI_EXPORT bool                  quasar_get_setting_bool(quasar_settings_t* settings, quasar_setting_handle setting);
+SAPI_EXPORT double                quasar_get_setting_double(quasar_settings_t* settings, quasar_setting_handle setting);
+SAPI_EXPORT uint32_t              quasar_get_settings_version(quasar_settings_t* settings);
+
+// A signal for a source without subscribers is dropped. The source is fetched
+// once when it gains a subscriber again, so a plugin may skip further signals
+// until its data has been fetched
 SAPI_EXPORT void quasar_signal_data_ready(quasar_plugin_handle handle, const char* source);
 SAPI_EXPORT void quasar_signal_wait_processed(quasar_plugin_handle handle, const char* source);
 
+// Background tasks
+//
+// Tasks run on a thread pool owned by Quasar. On plugin unload every task is
+// cancelled before shutdown() is called, and waited for after it returns.
+// Handles stay valid until released with quasar_task_release(). A released
+// one-shot task is freed once it has finished, other tasks when the plugin unloads
+//
+// flags is a combination of quasar_task_flags_t
+SAPI_EXPORT quasar_task_handle quasar_task_run(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, int flags);
+SAPI_EXPORT quasar_task_handle quasar_task_run_periodic(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, uint32_t intervalMsec, int flags);
+
+// Long running loop. fn should return once quasar_task_is_cancelled() is true
+SAPI_EXPORT quasar_task_handle quasar_task_run_loop(quasar_plugin_handle handle, quasar_task_call_t fn, void* userdata, int flags);
+
+SAPI_EXPORT void quasar_task_cancel(quasar_task_handle task);
+SAPI_EXPORT bool quasar_task_is_cancelled(quasar_task_handle task);
+
+// Sleeps up to msec, returns true as soon as the task is cancelled
+SAPI_EXPORT bool quasar_task_wait_cancelled(quasar_task_handle task, uint32_t msec);
+
+// Blocks until the task is done. Must not be called from the task itself
+SAPI_EXPORT void quasar_task_wait(quasar_task_handle task);
+
+// The handle must not be used afterwards, the task itself keeps running
+SAPI_EXPORT void quasar_task_release(quasar_task_handle task);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -1,7 +1,16 @@
 #pragma once
 
 #include <qstring_hash_impl.h>
+
+#include <atomic>
+#include <cstring>
+#include <deque>
 #include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QStringList>
 
 enum QuasarSettingEntryType
 {
@@ -14,6 +23,7 @@ struct quasar_setting_def_t
 {
     QuasarSettingEntryType type;
     QString                description;
+    size_t                 index; // slot in quasar_settings_t::values
 
     union
     {
@@ -45,5 +55,61 @@ struct quasar_setting_def_t
 
 struct quasar_settings_t
 {
-    std::unordered_map<QString, quasar_setting_def_t> map;
+    QStringHashMap<quasar_setting_def_t> map;
+
+    // Published setting values, read lock-free by plugin threads.
+    // Slots are only appended while the plugin builds its settings, so
+    // indices and addresses stay valid afterwards
+    std::deque<std::atomic<uint64_t>> values;
+
+    // Odd while an update is being published
+    std::atomic<uint32_t> version{0};
+};
+
+inline uint64_t quasar_encode_setting(const quasar_setting_def_t& def)
+{
+    switch (def.type)
+    {
+        case QUASAR_SETTING_ENTRY_INT:
+            return static_cast<uint64_t>(static_cast<int64_t>(def.inttype.val));
+
+        case QUASAR_SETTING_ENTRY_DOUBLE:
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &def.doubletype.val, sizeof(bits));
+            return bits;
+        }
+
+        case QUASAR_SETTING_ENTRY_BOOL:
+            return def.booltype.val ? 1 : 0;
+    }
+
+    return 0;
+}
+
+// Publishes def.val to plugin threads, called from the owning thread only
+inline void quasar_publish_setting(quasar_settings_t* settings, const quasar_setting_def_t& def)
+{
+    settings->version.fetch_add(1, std::memory_order_acq_rel);
+    settings->values[def.index].store(quasar_encode_setting(def), std::memory_order_release);
+    settings->version.fetch_add(1, std::memory_order_release);
+}
+
+// What a quasar_data_handle points to
+struct quasar_data_t
+{
+    QJsonValue value;
+    QByteArray raw;             // pre-serialized JSON, spliced verbatim into the message when set
+    QByteArray blob;            // opaque bytes, sent as a binary frame when set
+    bool       trusted = false; // skip validation of raw JSON
+    int        depth   = 0;     // open objects/arrays of the data builder
+    bool       extra   = false; // the data builder was asked for a second top level value
+
+    // Members of a top level builder object, kept as they are written when the
+    // source has a history so it does not parse raw back. numeric drops once a
+    // member is not a number
+    bool                history = false;
+    bool                numeric = false;
+    QStringList         keys;
+    std::vector<double> numbers;
 };
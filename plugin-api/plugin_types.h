@@ -10,7 +10,7 @@
 #    include <stdint.h>
 #endif
 
-#define QUASAR_API_VERSION 1
+#define QUASAR_API_VERSION 2
 
 #if defined(__cplusplus)
 extern "C" {
@@ -28,6 +28,20 @@ struct quasar_settings_t;
 
 typedef void* quasar_plugin_handle;
 typedef void* quasar_data_handle;
+typedef void* quasar_task_handle;
+
+// Index of a plugin setting, stable for the lifetime of its quasar_settings_t
+typedef intptr_t quasar_setting_handle;
+
+#define QUASAR_INVALID_SETTING_HANDLE ((quasar_setting_handle) -1)
+
+typedef void (*quasar_task_call_t)(quasar_task_handle task, void* userdata);
+
+enum quasar_task_flags_t
+{
+    QUASAR_TASK_NONE     = 0,
+    QUASAR_TASK_REALTIME = 1 // latency sensitive, runs at the highest thread priority
+};
 
 struct quasar_data_source_t
 {
@@ -42,6 +56,7 @@ struct quasar_plugin_info_t
     typedef quasar_settings_t* (*plugin_create_settings_call_t)();
     typedef void (*plugin_settings_call_t)(quasar_settings_t*);
     typedef bool (*plugin_get_data_call_t)(size_t, quasar_data_handle);
+    typedef bool (*plugin_get_data_batch_call_t)(const size_t*, quasar_data_handle*, bool*, size_t);
 
     // static info
     int  api_version;      // API version. Should always be initialized to QUASAR_API_VERSION
@@ -93,6 +108,19 @@ struct quasar_plugin_info_t
     //
     // This function should update local settings values
     plugin_settings_call_t update;
+
+    // get_data_batch(const size_t* uids, quasar_data_handle* handles, bool* ok, size_t count), optional, api_version >= 2
+    //
+    // Retrieves the data of several data entries at once, handles[i] receives data for uids[i]
+    //
+    // Called instead of get_data when more than one source is due at the same time,
+    // so shared state only needs to be sampled once. Set ok[i] to whether handles[i] was
+    // filled, entries left false are skipped and the rest are still sent
+    //
+    // returns true if every entry succeeded, false otherwise
+    //
+    // This function needs to be re-entrant
+    plugin_get_data_batch_call_t get_data_batch;
 };
 
 #if defined(__cplusplus)
@@ -0,0 +1,285 @@
+#include "plugintasks.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+
+namespace
+{
+    // Shared by every plugin so the total number of worker threads stays bounded
+    QThreadPool* task_pool()
+    {
+        static QThreadPool pool;
+        return &pool;
+    }
+
+    qint64 thread_cpu_time_ns()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        {
+            return 0;
+        }
+
+        auto to_int64 = [](const FILETIME& ft) { return (((qint64) ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+
+        // 100ns units
+        return (to_int64(kernel) + to_int64(user)) * 100;
+#else
+        timespec ts;
+
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        {
+            return 0;
+        }
+
+        return (qint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    }
+}
+
+class PluginTaskRunner : public QRunnable
+{
+public:
+    explicit PluginTaskRunner(quasar_task_t* task)
+        : m_task(task) {}
+
+    void run() override
+    {
+        QThread*          thread   = QThread::currentThread();
+        QThread::Priority priority = thread->priority();
+        bool              realtime = (m_task->flags & QUASAR_TASK_REALTIME);
+        bool              loop     = (m_task->kind == quasar_task_t::TASK_LOOP);
+
+        if (realtime)
+        {
+            thread->setPriority(QThread::TimeCriticalPriority);
+        }
+
+        if (loop)
+        {
+            // Long running loops mostly block, don't let them starve the pool
+            task_pool()->releaseThread();
+        }
+
+        if (!m_task->cancelled)
+        {
+            qint64 start = thread_cpu_time_ns();
+
+            m_task->fn(m_task, m_task->userdata);
+
+            m_task->owner->m_cpuns += thread_cpu_time_ns() - start;
+        }
+
+        if (loop)
+        {
+            task_pool()->reserveThread();
+        }
+
+        if (realtime)
+        {
+            thread->setPriority(priority);
+        }
+
+        // The task may be freed as soon as the lock is released
+        std::lock_guard<std::mutex> lk(m_task->mutex);
+        m_task->inflight--;
+        m_task->cv.notify_all();
+    }
+
+private:
+    quasar_task_t* m_task;
+};
+
+PluginTasks::~PluginTasks()
+{
+    cancelAll();
+    waitAll();
+
+    for (auto& task : m_tasks)
+    {
+        delete task->timer;
+    }
+}
+
+PluginTasks::PluginTasks(QString code, QObject* parent)
+    : QObject(parent), m_code(code)
+{}
+
+quasar_task_t* PluginTasks::run(quasar_task_t::TaskKind kind, quasar_task_call_t fn, void* userdata, uint32_t intervalMsec, int flags)
+{
+    if (!fn || (kind == quasar_task_t::TASK_PERIODIC && intervalMsec == 0))
+    {
+        qWarning() << "Plugin " << m_code << " submitted an invalid task";
+        return nullptr;
+    }
+
+    auto task      = std::make_unique<quasar_task_t>();
+    task->owner    = this;
+    task->kind     = kind;
+    task->fn       = fn;
+    task->userdata = userdata;
+    task->flags    = flags;
+
+    quasar_task_t* ptr = task.get();
+
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+
+        if (m_shutdown)
+        {
+            // Plugin is being unloaded
+            return nullptr;
+        }
+
+        prune();
+        m_tasks.push_back(std::move(task));
+    }
+
+    if (kind == quasar_task_t::TASK_PERIODIC)
+    {
+        ptr->timer = new QTimer();
+        ptr->timer->setInterval(intervalMsec);
+        ptr->timer->moveToThread(thread());
+
+        connect(ptr->timer, &QTimer::timeout, this, [this, ptr] { dispatch(ptr); });
+
+        // Timers can only be started from the thread they live in
+        QMetaObject::invokeMethod(this, "startPeriodic", Qt::AutoConnection, Q_ARG(void*, ptr));
+    }
+    else
+    {
+        dispatch(ptr);
+    }
+
+    return ptr;
+}
+
+void PluginTasks::startPeriodic(void* task)
+{
+    quasar_task_t* t = (quasar_task_t*) task;
+
+    if (!t->cancelled)
+    {
+        t->timer->start();
+    }
+}
+
+void PluginTasks::dispatch(quasar_task_t* task)
+{
+    {
+        std::lock_guard<std::mutex> lk(task->mutex);
+
+        if (task->cancelled)
+        {
+            return;
+        }
+
+        // Skip a tick rather than pile up runs of a slow periodic task
+        if (task->kind == quasar_task_t::TASK_PERIODIC && task->inflight > 0)
+        {
+            return;
+        }
+
+        task->inflight++;
+    }
+
+    task_pool()->start(new PluginTaskRunner(task), (task->flags & QUASAR_TASK_REALTIME) ? 1 : 0);
+}
+
+void PluginTasks::prune()
+{
+    // Finished one-shot tasks the plugin has released are freed, callers hold m_mutex
+    auto it = std::remove_if(m_tasks.begin(), m_tasks.end(), [](const std::unique_ptr<quasar_task_t>& t) {
+        if (t->kind != quasar_task_t::TASK_ONESHOT || !t->released)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lk(t->mutex);
+        return t->inflight == 0;
+    });
+
+    m_tasks.erase(it, m_tasks.end());
+}
+
+void PluginTasks::cancel(quasar_task_t* task)
+{
+    {
+        std::lock_guard<std::mutex> lk(task->mutex);
+        task->cancelled = true;
+    }
+
+    task->cv.notify_all();
+
+    if (task->timer && QThread::currentThread() == thread())
+    {
+        task->timer->stop();
+    }
+}
+
+void PluginTasks::release(quasar_task_t* task)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+
+    task->released = true;
+    prune();
+}
+
+void PluginTasks::cancelAll()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+
+    // No new tasks from here on, so handles stay valid until destruction
+    m_shutdown = true;
+
+    for (auto& task : m_tasks)
+    {
+        cancel(task.get());
+    }
+}
+
+void PluginTasks::wait(quasar_task_t* task)
+{
+    std::unique_lock<std::mutex> lk(task->mutex);
+    task->cv.wait(lk, [task] { return task->inflight == 0; });
+}
+
+void PluginTasks::waitAll()
+{
+    std::vector<quasar_task_t*> tasks;
+
+    {
+        // Running tasks may still submit more work, so don't wait while holding the lock
+        std::lock_guard<std::mutex> lk(m_mutex);
+
+        for (auto& task : m_tasks)
+        {
+            tasks.push_back(task.get());
+        }
+    }
+
+    for (quasar_task_t* task : tasks)
+    {
+        wait(task);
+    }
+}
+
+bool PluginTasks::waitCancelled(quasar_task_t* task, uint32_t msec)
+{
+    std::unique_lock<std::mutex> lk(task->mutex);
+    return task->cv.wait_for(lk, std::chrono::milliseconds(msec), [task] { return task->cancelled.load(); });
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <plugin_types.h>
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+class PluginTasks;
+
+// What a quasar_task_handle points to
+struct quasar_task_t
+{
+    enum TaskKind
+    {
+        TASK_ONESHOT,
+        TASK_PERIODIC,
+        TASK_LOOP
+    };
+
+    PluginTasks*       owner;
+    TaskKind           kind;
+    quasar_task_call_t fn;
+    void*              userdata;
+    int                flags;
+
+    std::atomic<bool>       cancelled{ false };
+    std::mutex              mutex;
+    std::condition_variable cv;
+    int                     inflight = 0;     // runs queued or executing
+    bool                    released = false; // by the plugin, guarded by the owner's lock
+
+    QTimer* timer = nullptr;
+};
+
+// Background work submitted by one plugin, executed on a thread pool shared by all plugins
+class PluginTasks : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~PluginTasks();
+    explicit PluginTasks(QString code, QObject* parent = Q_NULLPTR);
+    PluginTasks(const PluginTasks&) = delete;
+    PluginTasks& operator=(const PluginTasks&) = delete;
+
+    quasar_task_t* run(quasar_task_t::TaskKind kind, quasar_task_call_t fn, void* userdata, uint32_t intervalMsec, int flags);
+
+    void cancel(quasar_task_t* task);
+    void cancelAll();
+
+    // The plugin is done with the handle, a one-shot task is freed once it has finished
+    void release(quasar_task_t* task);
+
+    // Blocks until the task is no longer queued or executing
+    void wait(quasar_task_t* task);
+
+    // Only valid after cancelAll(), which stops new tasks from being added
+    void waitAll();
+
+    // Sleeps up to msec, returns early with true once the task is cancelled
+    bool waitCancelled(quasar_task_t* task, uint32_t msec);
+
+    // CPU time consumed by this plugin's tasks
+    qint64 cpuTimeMsec() const { return m_cpuns.load() / 1000000; }
+
+private slots:
+    void startPeriodic(void* task);
+
+private:
+    friend class PluginTaskRunner;
+
+    void dispatch(quasar_task_t* task);
+    void prune();
+
+    QString m_code;
+
+    std::mutex                                  m_mutex;
+    std::vector<std::unique_ptr<quasar_task_t>> m_tasks;
+    bool                                        m_shutdown = false;
+
+    std::atomic<qint64> m_cpuns{ 0 };
+};
@@ -1,6 +1,508 @@
 #pragma once
 
 #include <QString>
+#include <QStringView>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace QStringHashDetail
+{
+    // FNV-1a over UTF-16 code units, so the same text hashes the same
+    // whether it arrives as UTF-16 or Latin-1
+#if SIZE_MAX > 0xFFFFFFFFu
+    constexpr std::size_t basis = 14695981039346656037ull;
+    constexpr std::size_t prime = 1099511628211ull;
+#else
+    constexpr std::size_t basis = 2166136261u;
+    constexpr std::size_t prime = 16777619u;
+#endif
+
+    template <typename Char>
+    inline std::size_t hash(const Char* data, qsizetype len) noexcept
+    {
+        std::size_t h = basis;
+
+        for (qsizetype i = 0; i < len; i++)
+        {
+            h = (h ^ static_cast<std::size_t>(data[i])) * prime;
+        }
+
+        return h;
+    }
+
+    // Decodes NUL terminated UTF-8 into the UTF-16 code units QString::fromUtf8
+    // would produce, one at a time. Malformed sequences decode to U+FFFD per byte
+    class Utf8Decoder
+    {
+    public:
+        explicit Utf8Decoder(const char* s)
+            : m_s(reinterpret_cast<const uchar*>(s)) {}
+
+        bool next(char16_t& unit) noexcept
+        {
+            if (m_low)
+            {
+                unit  = m_low;
+                m_low = 0;
+                return true;
+            }
+
+            uchar b0 = m_s[0];
+
+            if (b0 == 0)
+            {
+                return false;
+            }
+
+            char32_t cp  = 0xFFFD;
+            int      len = 1;
+
+            auto cont = [this](int i) { return (m_s[i] & 0xC0) == 0x80; };
+
+            if (b0 < 0x80)
+            {
+                cp = b0;
+            }
+            else if (b0 >= 0xC2 && b0 <= 0xDF && cont(1))
+            {
+                cp  = ((b0 & 0x1F) << 6) | (m_s[1] & 0x3F);
+                len = 2;
+            }
+            else if (b0 >= 0xE0 && b0 <= 0xEF && cont(1) && cont(2) &&
+                     (b0 != 0xE0 || m_s[1] >= 0xA0) && (b0 != 0xED || m_s[1] < 0xA0))
+            {
+                cp  = ((b0 & 0x0F) << 12) | ((m_s[1] & 0x3F) << 6) | (m_s[2] & 0x3F);
+                len = 3;
+            }
+            else if (b0 >= 0xF0 && b0 <= 0xF4 && cont(1) && cont(2) && cont(3) &&
+                     (b0 != 0xF0 || m_s[1] >= 0x90) && (b0 != 0xF4 || m_s[1] < 0x90))
+            {
+                cp  = ((b0 & 0x07) << 18) | ((m_s[1] & 0x3F) << 12) | ((m_s[2] & 0x3F) << 6) | (m_s[3] & 0x3F);
+                len = 4;
+            }
+
+            m_s += len;
+
+            if (cp >= 0x10000)
+            {
+                unit  = static_cast<char16_t>(0xD800 + ((cp - 0x10000) >> 10));
+                m_low = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+            }
+            else
+            {
+                unit = static_cast<char16_t>(cp);
+            }
+
+            return true;
+        }
+
+    private:
+        const uchar* m_s;
+        char16_t     m_low = 0; // second half of a surrogate pair
+    };
+} // namespace QStringHashDetail
+
+// Hashes QString, QStringView, QLatin1String and UTF-8 keys without allocating
+struct QStringHash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(QStringView s) const noexcept
+    {
+        return QStringHashDetail::hash(s.utf16(), s.size());
+    }
+
+    std::size_t operator()(const QString& s) const noexcept
+    {
+        return QStringHashDetail::hash(s.utf16(), s.size());
+    }
+
+    std::size_t operator()(QLatin1String s) const noexcept
+    {
+        return QStringHashDetail::hash(reinterpret_cast<const uchar*>(s.data()), s.size());
+    }
+
+    std::size_t operator()(const char* utf8) const noexcept
+    {
+        QStringHashDetail::Utf8Decoder dec(utf8);
+
+        std::size_t h = QStringHashDetail::basis;
+        char16_t    unit;
+
+        while (dec.next(unit))
+        {
+            h = (h ^ static_cast<std::size_t>(unit)) * QStringHashDetail::prime;
+        }
+
+        return h;
+    }
+};
+
+struct QStringEqual
+{
+    using is_transparent = void;
+
+    static bool equal(QStringView a, QStringView b) noexcept
+    {
+        return a.size() == b.size() && std::equal(a.utf16(), a.utf16() + a.size(), b.utf16());
+    }
+
+    static bool equal(QStringView a, QLatin1String b) noexcept
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+
+        for (qsizetype i = 0; i < a.size(); i++)
+        {
+            if (a.utf16()[i] != static_cast<uchar>(b.data()[i]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool equal(QStringView a, const char* utf8) noexcept
+    {
+        QStringHashDetail::Utf8Decoder dec(utf8);
+
+        char16_t  unit;
+        qsizetype i = 0;
+
+        while (dec.next(unit))
+        {
+            if (i == a.size() || a.utf16()[i++] != unit)
+            {
+                return false;
+            }
+        }
+
+        return i == a.size();
+    }
+
+    bool operator()(const QString& a, const QString& b) const noexcept { return a == b; }
+    bool operator()(const QString& a, QStringView b) const noexcept { return equal(a, b); }
+    bool operator()(QStringView a, const QString& b) const noexcept { return equal(a, b); }
+    bool operator()(const QString& a, QLatin1String b) const noexcept { return equal(a, b); }
+    bool operator()(QLatin1String a, const QString& b) const noexcept { return equal(b, a); }
+    bool operator()(const QString& a, const char* b) const noexcept { return equal(a, b); }
+    bool operator()(const char* a, const QString& b) const noexcept { return equal(b, a); }
+};
+
+// Hash map keyed by QString that finds QString, QStringView, QLatin1String and
+// UTF-8 const char* keys without converting them, so lookups never allocate.
+// Open addressing with linear probing over an index of the entries, which are
+// allocated once each so references to them stay valid until they are erased.
+// Follows the std::unordered_map interface as far as it is used here; iteration
+// is in insertion order until something is erased
+template <typename T>
+class QStringHashMap
+{
+public:
+    using key_type    = QString;
+    using mapped_type = T;
+    using value_type  = std::pair<const QString, T>;
+    using size_type   = std::size_t;
+
+private:
+    using NodeList = std::vector<std::unique_ptr<value_type>>;
+
+    template <typename It, typename V>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = V;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = V*;
+        using reference         = V&;
+
+        Iterator() = default;
+        explicit Iterator(It it)
+            : m_it(it) {}
+
+        // iterator to const_iterator
+        template <typename OtherIt, typename OtherV>
+        Iterator(const Iterator<OtherIt, OtherV>& other)
+            : m_it(other.m_it) {}
+
+        reference operator*() const { return **m_it; }
+        pointer   operator->() const { return m_it->get(); }
+
+        Iterator& operator++()
+        {
+            ++m_it;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator tmp = *this;
+            ++m_it;
+            return tmp;
+        }
+
+        template <typename OtherIt, typename OtherV>
+        bool operator==(const Iterator<OtherIt, OtherV>& other) const { return m_it == other.m_it; }
+        template <typename OtherIt, typename OtherV>
+        bool operator!=(const Iterator<OtherIt, OtherV>& other) const { return m_it != other.m_it; }
+
+    private:
+        template <typename, typename>
+        friend class Iterator;
+        friend class QStringHashMap;
+
+        It m_it;
+    };
+
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot
+    {
+        std::size_t hash;
+        uint32_t    index; // into m_nodes, EMPTY if unused
+    };
+
+public:
+    using iterator       = Iterator<typename NodeList::iterator, value_type>;
+    using const_iterator = Iterator<typename NodeList::const_iterator, const value_type>;
+
+    QStringHashMap() = default;
+    QStringHashMap(QStringHashMap&&) noexcept = default;
+    QStringHashMap& operator=(QStringHashMap&&) noexcept = default;
+    QStringHashMap(const QStringHashMap&) = delete;
+    QStringHashMap& operator=(const QStringHashMap&) = delete;
+
+    iterator       begin() noexcept { return iterator(m_nodes.begin()); }
+    iterator       end() noexcept { return iterator(m_nodes.end()); }
+    const_iterator begin() const noexcept { return const_iterator(m_nodes.begin()); }
+    const_iterator end() const noexcept { return const_iterator(m_nodes.end()); }
+
+    size_type size() const noexcept { return m_nodes.size(); }
+    bool      empty() const noexcept { return m_nodes.empty(); }
+
+    // Key is a QString, QStringView, QLatin1String or UTF-8 const char*
+    template <typename K>
+    iterator find(const K& key)
+    {
+        uint32_t idx = indexOf(key, QStringHash{}(key));
+        return (idx == EMPTY) ? end() : iterator(m_nodes.begin() + idx);
+    }
+
+    template <typename K>
+    const_iterator find(const K& key) const
+    {
+        uint32_t idx = indexOf(key, QStringHash{}(key));
+        return (idx == EMPTY) ? end() : const_iterator(m_nodes.begin() + idx);
+    }
+
+    template <typename K>
+    size_type count(const K& key) const
+    {
+        return indexOf(key, QStringHash{}(key)) == EMPTY ? 0 : 1;
+    }
+
+    T& operator[](const QString& key)
+    {
+        return emplaceNode(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first->second;
+    }
+
+    template <typename P>
+    std::pair<iterator, bool> insert(P&& value)
+    {
+        return emplaceNode(value.first, std::forward<P>(value));
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> emplace(const QString& key, V&& value)
+    {
+        return emplaceNode(key, key, std::forward<V>(value));
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        uint32_t idx  = static_cast<uint32_t>(pos.m_it - m_nodes.cbegin());
+        uint32_t last = static_cast<uint32_t>(m_nodes.size() - 1);
+
+        removeSlot(slotOf(idx));
+
+        // Fill the gap with the last entry so the entries stay dense
+        if (idx != last)
+        {
+            m_slots[slotOf(last)].index = idx;
+            m_nodes[idx]                = std::move(m_nodes[last]);
+            m_hashes[idx]               = m_hashes[last];
+        }
+
+        m_nodes.pop_back();
+        m_hashes.pop_back();
+
+        return iterator(m_nodes.begin() + idx);
+    }
+
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+    template <typename K>
+    size_type erase(const K& key)
+    {
+        auto it = find(key);
+
+        if (it == end())
+        {
+            return 0;
+        }
+
+        erase(it);
+        return 1;
+    }
+
+    void clear() noexcept
+    {
+        m_nodes.clear();
+        m_hashes.clear();
+        std::fill(m_slots.begin(), m_slots.end(), Slot{ 0, EMPTY });
+    }
+
+    void reserve(size_type n)
+    {
+        m_nodes.reserve(n);
+        m_hashes.reserve(n);
+
+        if (n * 2 > m_slots.size())
+        {
+            rehash(n * 2);
+        }
+    }
+
+private:
+    size_t mask() const { return m_slots.size() - 1; }
+
+    template <typename K>
+    uint32_t indexOf(const K& key, std::size_t h) const
+    {
+        if (m_slots.empty())
+        {
+            return EMPTY;
+        }
+
+        for (size_t i = h & mask();; i = (i + 1) & mask())
+        {
+            const Slot& s = m_slots[i];
+
+            if (s.index == EMPTY)
+            {
+                return EMPTY;
+            }
+
+            if (s.hash == h && QStringEqual{}(m_nodes[s.index]->first, key))
+            {
+                return s.index;
+            }
+        }
+    }
+
+    // Slot holding the entry at idx
+    size_t slotOf(uint32_t idx) const
+    {
+        size_t i = m_hashes[idx] & mask();
+
+        while (m_slots[i].index != idx)
+        {
+            i = (i + 1) & mask();
+        }
+
+        return i;
+    }
+
+    // Backward shift deletion, later entries of the probe run move up into the hole
+    void removeSlot(size_t hole)
+    {
+        for (size_t j = (hole + 1) & mask(); m_slots[j].index != EMPTY; j = (j + 1) & mask())
+        {
+            size_t home = m_slots[j].hash & mask();
+
+            if (((j - home) & mask()) >= ((j - hole) & mask()))
+            {
+                m_slots[hole] = m_slots[j];
+                hole          = j;
+            }
+        }
+
+        m_slots[hole] = Slot{ 0, EMPTY };
+    }
+
+    void rehash(size_type minslots)
+    {
+        size_type n = 8;
+
+        while (n < minslots)
+        {
+            n *= 2;
+        }
+
+        m_slots.assign(n, Slot{ 0, EMPTY });
+
+        for (uint32_t idx = 0; idx < m_nodes.size(); idx++)
+        {
+            size_t i = m_hashes[idx] & mask();
+
+            while (m_slots[i].index != EMPTY)
+            {
+                i = (i + 1) & mask();
+            }
+
+            m_slots[i] = Slot{ m_hashes[idx], idx };
+        }
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplaceNode(const QString& key, Args&&... args)
+    {
+        std::size_t h   = QStringHash{}(key);
+        uint32_t    idx = indexOf(key, h);
+
+        if (idx != EMPTY)
+        {
+            return { iterator(m_nodes.begin() + idx), false };
+        }
+
+        // At most half full
+        if ((m_nodes.size() + 1) * 2 > m_slots.size())
+        {
+            rehash((m_nodes.size() + 1) * 2);
+        }
+
+        idx = static_cast<uint32_t>(m_nodes.size());
+
+        m_nodes.push_back(std::make_unique<value_type>(std::forward<Args>(args)...));
+        m_hashes.push_back(h);
+
+        size_t i = h & mask();
+
+        while (m_slots[i].index != EMPTY)
+        {
+            i = (i + 1) & mask();
+        }
+
+        m_slots[i] = Slot{ h, idx };
+
+        return { iterator(m_nodes.begin() + idx), true };
+    }
+
+    NodeList                 m_nodes;
+    std::vector<std::size_t> m_hashes; // of m_nodes
+    std::vector<Slot>        m_slots;  // power of two sized
+};
 
 namespace std
 {
@@ -9,9 +511,9 @@ namespace std
     {
         typedef QString     argument_type;
         typedef std::size_t result_type;
-        result_type         operator()(argument_type const& s) const
+        result_type         operator()(argument_type const& s) const noexcept
         {
-            return std::hash<std::string>{}(s.toStdString());
+            return QStringHash{}(s);
         }
     };
 }
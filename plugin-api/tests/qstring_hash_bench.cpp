@@ -0,0 +1,67 @@
+// Lookup cost of QStringHashMap by UTF-8 and QString keys, against
+// std::unordered_map<QString> which has to convert UTF-8 keys first
+
+#include <qstring_hash_impl.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define BENCH_KEYS 64
+#define BENCH_ROUNDS 20000
+
+namespace
+{
+    volatile size_t g_sink = 0;
+
+    template <typename F>
+    double nsPerLookup(F&& lookup)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+        {
+            for (size_t i = 0; i < BENCH_KEYS; i++)
+            {
+                g_sink = g_sink + lookup(i);
+            }
+        }
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / (BENCH_ROUNDS * BENCH_KEYS);
+    }
+} // namespace
+
+int main()
+{
+    // Keys shaped like data source and setting names
+    std::vector<std::string> names;
+    std::vector<QString>     keys;
+
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+    {
+        names.push_back("source_" + std::to_string(i * 7919) + "_setting");
+        keys.push_back(QString(names.back().c_str()));
+    }
+
+    QStringHashMap<size_t>                          map;
+    std::unordered_map<QString, size_t, QStringHash> std_map;
+
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+    {
+        map[keys[i]]     = i;
+        std_map[keys[i]] = i;
+    }
+
+    double hash_utf8    = nsPerLookup([&](size_t i) { return map.find(names[i].c_str())->second; });
+    double hash_qstring = nsPerLookup([&](size_t i) { return map.find(keys[i])->second; });
+    double std_utf8     = nsPerLookup([&](size_t i) { return std_map.find(QString(names[i].c_str()))->second; });
+    double std_qstring  = nsPerLookup([&](size_t i) { return std_map.find(keys[i])->second; });
+
+    std::printf("QStringHashMap       const char* %6.1f ns  QString %6.1f ns\n", hash_utf8, hash_qstring);
+    std::printf("std::unordered_map   const char* %6.1f ns  QString %6.1f ns\n", std_utf8, std_qstring);
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Checks QStringHashMap against std::map under random inserts, erases and
+// lookups, and that lookups by any supported key type never allocate
+
+#include <qstring_hash_impl.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+
+namespace
+{
+    std::atomic<long> g_allocations{ 0 };
+
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, int line)
+    {
+        if (!ok)
+        {
+            std::fprintf(stderr, "line %d: %s\n", line, what);
+            g_failures++;
+        }
+    }
+
+    QString key(const std::string& s) { return QString(s.c_str()); }
+
+    struct NoCopy
+    {
+        std::unique_ptr<int> p;
+        int                  v = 0;
+    };
+} // namespace
+
+// Asserts are compiled out in release builds
+#define CHECK(x) check((x), #x, __LINE__)
+
+void* operator new(std::size_t size)
+{
+    g_allocations++;
+
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static void testKeyTypes()
+{
+    QStringHashMap<int> m;
+
+    m[QString("alpha")]                = 1;
+    m[QString("b\xC3\xA9ta")]          = 2; // two byte UTF-8
+    m[QString("\xF0\x9F\x98\x80x")]    = 3; // surrogate pair
+    m[QString("\xE2\x82\xAC" "euro")] = 4; // three byte UTF-8
+
+    QString    alpha("alpha");
+    QStringView view(alpha);
+
+    long before = g_allocations;
+
+    CHECK(m.find("alpha") != m.end() && m.find("alpha")->second == 1);
+    CHECK(m.find("b\xC3\xA9ta") != m.end() && m.find("b\xC3\xA9ta")->second == 2);
+    CHECK(m.find("\xF0\x9F\x98\x80x") != m.end() && m.find("\xF0\x9F\x98\x80x")->second == 3);
+    CHECK(m.find("\xE2\x82\xAC" "euro") != m.end());
+    CHECK(m.find(QLatin1String("alpha")) != m.end());
+    CHECK(m.find(view) != m.end());
+    CHECK(m.find(alpha) != m.end());
+    CHECK(m.find("bet") == m.end());
+    CHECK(m.find("alph") == m.end());
+    CHECK(m.find("alphaa") == m.end());
+    CHECK(m.find("\xC3") == m.end()); // truncated sequence
+    CHECK(m.count("b\xC3\xA9ta") == 1);
+
+    CHECK(g_allocations == before);
+}
+
+static void testAgainstStdMap()
+{
+    std::mt19937               rng(1);
+    std::map<std::string, int> ref;
+    QStringHashMap<int>        map;
+
+    for (int i = 0; i < 200000; i++)
+    {
+        std::string k = "k" + std::to_string(rng() % 300);
+
+        switch (rng() % 4)
+        {
+            case 0:
+                ref[k]      = i;
+                map[key(k)] = i;
+                break;
+
+            case 1:
+                CHECK(ref.erase(k) == map.erase(k.c_str()));
+                break;
+
+            case 2:
+            {
+                auto it  = map.find(k.c_str());
+                auto rit = ref.find(k);
+
+                CHECK((it == map.end()) == (rit == ref.end()));
+                CHECK(rit == ref.end() || it->second == rit->second);
+                break;
+            }
+
+            default:
+            {
+                auto r    = map.insert(std::make_pair(key(k), i));
+                auto rref = ref.insert({ k, i });
+
+                CHECK(r.second == rref.second);
+                CHECK(r.first->second == rref.first->second);
+                break;
+            }
+        }
+
+        CHECK(map.size() == ref.size());
+    }
+
+    // Erase while iterating
+    for (auto it = map.begin(); it != map.end();)
+    {
+        if (it->second % 2)
+            it = map.erase(it);
+        else
+            ++it;
+    }
+
+    size_t even = 0;
+
+    for (auto& e : ref)
+    {
+        if (e.second % 2 == 0)
+        {
+            even++;
+            CHECK(map.find(e.first.c_str()) != map.end());
+        }
+    }
+
+    CHECK(even == map.size());
+
+    for (auto& e : map)
+    {
+        CHECK(e.second % 2 == 0);
+    }
+}
+
+static void testStableReferences()
+{
+    QStringHashMap<NoCopy> map;
+
+    NoCopy& x = map[QString("x")];
+    x.v       = 5;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        map[key(std::to_string(i))];
+    }
+
+    for (int i = 0; i < 1000; i += 2)
+    {
+        map.erase(std::to_string(i).c_str());
+    }
+
+    CHECK(&map[QString("x")] == &x && x.v == 5);
+
+    QStringHashMap<std::unique_ptr<int>> owning;
+    owning.insert(std::make_pair(QString("a"), std::unique_ptr<int>(new int(3))));
+    CHECK(*owning.find("a")->second == 3);
+
+    QStringHashMap<size_t> e;
+    CHECK(e.emplace(QString("t"), e.size()).second);
+    CHECK(!e.emplace(QString("t"), 5).second);
+
+    const auto& ce = e;
+    CHECK(ce.find("t") != ce.end());
+
+    e.clear();
+    CHECK(e.find("t") == e.end() && e.empty());
+
+    e.reserve(100);
+    e[QString("z")] = 1;
+    CHECK(e.count("z") == 1);
+}
+
+int main()
+{
+    testKeyTypes();
+    testAgainstStdMap();
+    testStableReferences();
+
+    if (g_failures)
+    {
+        std::fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,335 @@
+#include "capture.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <plugin_support.h>
+
+#define qlog(l, f, ...)                                                   \
+    {                                                                     \
+        char msg[256];                                                    \
+        snprintf(msg, sizeof(msg), "linux_audio_viz: " f, ##__VA_ARGS__); \
+        quasar_log(l, msg);                                               \
+    }
+
+#define warn(f, ...) qlog(QUASAR_LOG_WARNING, f, ##__VA_ARGS__)
+
+// WAV playback is paced in blocks of this length
+#define WAV_BLOCK_MSEC 10
+
+namespace
+{
+    uint64_t now_msec()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    // Waits for fd to become readable or for wakeFd, returns false when woken up
+    bool wait_readable(int fd, int wakeFd, int timeoutMsec)
+    {
+        pollfd fds[2] = { { wakeFd, POLLIN, 0 }, { fd, POLLIN, 0 } };
+
+        int n = poll(fds, fd < 0 ? 1 : 2, timeoutMsec);
+
+        return !(n > 0 && fds[0].revents) && !(n < 0 && errno != EINTR);
+    }
+
+    SampleFormat parse_format(const std::string& name)
+    {
+        if (name == "s16le" || name == "s16")
+            return SAMPLE_S16LE;
+        if (name == "f32le" || name == "f32" || name == "float32le")
+            return SAMPLE_F32LE;
+
+        return SAMPLE_INV;
+    }
+
+    uint16_t le16(const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    uint32_t le32(const uint8_t* p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+}
+
+std::unique_ptr<CaptureBackend> CaptureBackend::create(const std::string& source, const std::string& fmt)
+{
+    size_t colon = source.find(':');
+
+    std::string kind = source.substr(0, colon);
+    std::string path = colon == std::string::npos ? std::string() : source.substr(colon + 1);
+
+    if (path.empty())
+    {
+        warn("No path in audio source \"%s\"", source.c_str());
+        return nullptr;
+    }
+
+    if (kind == "wav")
+    {
+        return std::make_unique<WavCapture>(path);
+    }
+
+    if (kind == "fifo")
+    {
+        // format[:rate[:channels]]
+        char     name[16] = {};
+        unsigned rate     = 44100;
+        unsigned channels = 2;
+
+        sscanf(fmt.c_str(), "%15[^:]:%u:%u", name, &rate, &channels);
+
+        SampleFormat format = parse_format(name);
+
+        if (format == SAMPLE_INV || !rate || !channels)
+        {
+            warn("Unsupported raw audio format \"%s\"", fmt.c_str());
+            return nullptr;
+        }
+
+        return std::make_unique<FifoCapture>(path, format, rate, channels);
+    }
+
+    warn("Unknown audio source \"%s\"", source.c_str());
+    return nullptr;
+}
+
+FifoCapture::FifoCapture(std::string path, SampleFormat format, unsigned rate, unsigned channels)
+    : m_path(path)
+{
+    m_format   = format;
+    m_rate     = rate;
+    m_channels = channels;
+}
+
+FifoCapture::~FifoCapture()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+    if (m_keepw >= 0)
+        close(m_keepw);
+}
+
+bool FifoCapture::open()
+{
+    if (mkfifo(m_path.c_str(), 0600) != 0 && errno != EEXIST)
+    {
+        warn("Failed to create %s: %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+
+    if (stat(m_path.c_str(), &st) != 0 || !S_ISFIFO(st.st_mode))
+    {
+        warn("%s is not a named pipe", m_path.c_str());
+        return false;
+    }
+
+    // Non-blocking so opening does not wait for a writer
+    m_fd = ::open(m_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (m_fd < 0)
+    {
+        warn("Failed to open %s: %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    m_keepw = ::open(m_path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (m_keepw < 0)
+    {
+        warn("Failed to open %s for writing: %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+ssize_t FifoCapture::read(void* buf, size_t len, int wakeFd)
+{
+    while (true)
+    {
+        ssize_t n = ::read(m_fd, buf, len);
+
+        if (n > 0)
+        {
+            return n;
+        }
+
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            warn("Failed to read %s: %s", m_path.c_str(), strerror(errno));
+            return -1;
+        }
+
+        if (!wait_readable(m_fd, wakeFd, -1))
+        {
+            return 0;
+        }
+    }
+}
+
+WavCapture::WavCapture(std::string path)
+    : m_path(path)
+{
+}
+
+WavCapture::~WavCapture()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool WavCapture::open()
+{
+    m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (m_fd < 0)
+    {
+        warn("Failed to open %s: %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    uint8_t hdr[12];
+
+    if (pread(m_fd, hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+    {
+        warn("%s is not a WAV file", m_path.c_str());
+        return false;
+    }
+
+    // Walk the chunks for the format and the samples
+    off_t    off  = sizeof(hdr);
+    unsigned bits = 0;
+    unsigned tag  = 0;
+
+    while (!m_data)
+    {
+        uint8_t chunk[8];
+
+        if (pread(m_fd, chunk, sizeof(chunk), off) != sizeof(chunk))
+        {
+            break;
+        }
+
+        uint32_t size = le32(chunk + 4);
+        off += sizeof(chunk);
+
+        if (!memcmp(chunk, "fmt ", 4))
+        {
+            uint8_t fmt[40] = {};
+
+            if (size < 16 || pread(m_fd, fmt, std::min<size_t>(size, sizeof(fmt)), off) < 16)
+            {
+                break;
+            }
+
+            tag        = le16(fmt);
+            m_channels = le16(fmt + 2);
+            m_rate     = le32(fmt + 4);
+            bits       = le16(fmt + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE, the actual tag leads the subformat GUID
+            if (tag == 0xfffe && size >= 26)
+            {
+                tag = le16(fmt + 24);
+            }
+        }
+        else if (!memcmp(chunk, "data", 4))
+        {
+            m_data = off;
+            m_size = size;
+        }
+
+        // Chunks are padded to an even size
+        off += size + (size & 1);
+    }
+
+    if (tag == 1 && bits == 16)
+    {
+        m_format = SAMPLE_S16LE;
+    }
+    else if (tag == 3 && bits == 32)
+    {
+        m_format = SAMPLE_F32LE;
+    }
+
+    if (!m_data || m_format == SAMPLE_INV || !m_rate || !m_channels)
+    {
+        warn("%s: only 16-bit PCM and 32-bit float WAV files are supported", m_path.c_str());
+        return false;
+    }
+
+    // A truncated file plays what is there
+    struct stat st;
+
+    if (fstat(m_fd, &st) == 0 && (off_t) (m_data + m_size) > st.st_size)
+    {
+        m_size = st.st_size - m_data;
+    }
+
+    m_size -= m_size % frameSize();
+
+    if (!m_size)
+    {
+        warn("%s has no samples", m_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+ssize_t WavCapture::read(void* buf, size_t len, int wakeFd)
+{
+    const size_t frame = frameSize();
+
+    if (!m_start)
+    {
+        m_start = now_msec();
+    }
+
+    // Hold back until the previous block has played
+    uint64_t due = m_start + m_played * 1000 / m_rate;
+    uint64_t now = now_msec();
+
+    if (due > now && !wait_readable(-1, wakeFd, (int) (due - now)))
+    {
+        return 0;
+    }
+
+    len = std::min<size_t>(len, (size_t) m_rate * WAV_BLOCK_MSEC / 1000 * frame);
+    len = std::min(len - len % frame, m_size - m_pos);
+
+    ssize_t n = pread(m_fd, buf, len, m_data + m_pos);
+
+    if (n <= 0)
+    {
+        warn("Failed to read %s: %s", m_path.c_str(), n < 0 ? strerror(errno) : "unexpected end of file");
+        return -1;
+    }
+
+    m_pos += n;
+    m_played += n / frame;
+
+    if (m_pos >= m_size)
+    {
+        m_pos = 0;
+    }
+
+    return n;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum SampleFormat
+{
+    SAMPLE_INV,
+    SAMPLE_S16LE,
+    SAMPLE_F32LE
+};
+
+// Source of interleaved PCM for the visualizer
+class CaptureBackend
+{
+public:
+    virtual ~CaptureBackend() = default;
+
+    virtual bool open() = 0;
+
+    // Blocks until samples arrive or wakeFd becomes readable. Returns the number of
+    // bytes read, 0 when woken up and -1 on error
+    virtual ssize_t read(void* buf, size_t len, int wakeFd) = 0;
+
+    virtual const char* name() const = 0;
+
+    SampleFormat format() const { return m_format; }
+    unsigned     rate() const { return m_rate; }
+    unsigned     channels() const { return m_channels; }
+    size_t       frameSize() const { return m_channels * (m_format == SAMPLE_S16LE ? 2 : 4); }
+
+    // "fifo:<path>" or "wav:<path>", fmt is "s16le|f32le[:rate[:channels]]" for raw PCM
+    static std::unique_ptr<CaptureBackend> create(const std::string& source, const std::string& fmt);
+
+protected:
+    SampleFormat m_format   = SAMPLE_INV;
+    unsigned     m_rate     = 0;
+    unsigned     m_channels = 0;
+};
+
+// Raw PCM written to a named pipe, i.e. by
+//   parec -d @DEFAULT_MONITOR@ --format=s16le --rate=44100 --channels=2 > /tmp/quasar-audio
+// or a PipeWire recorder writing to stdout. Writers may come and go
+class FifoCapture : public CaptureBackend
+{
+public:
+    FifoCapture(std::string path, SampleFormat format, unsigned rate, unsigned channels);
+    ~FifoCapture();
+
+    bool        open() override;
+    ssize_t     read(void* buf, size_t len, int wakeFd) override;
+    const char* name() const override { return "fifo"; }
+
+private:
+    std::string m_path;
+    int         m_fd    = -1;
+    int         m_keepw = -1; // own write end, so the pipe never reports EOF between writers
+};
+
+// Plays a 16-bit PCM or 32-bit float WAV file in a loop at its own sample rate,
+// for testing and benchmarking without sound hardware
+class WavCapture : public CaptureBackend
+{
+public:
+    WavCapture(std::string path);
+    ~WavCapture();
+
+    bool        open() override;
+    ssize_t     read(void* buf, size_t len, int wakeFd) override;
+    const char* name() const override { return "wav"; }
+
+private:
+    std::string m_path;
+    int         m_fd     = -1;
+    off_t       m_data   = 0; // offset of the sample data
+    size_t      m_size   = 0; // bytes of sample data
+    size_t      m_pos    = 0; // next byte to play, relative to m_data
+    uint64_t    m_played = 0; // frames since m_start
+    uint64_t    m_start  = 0; // msec
+};
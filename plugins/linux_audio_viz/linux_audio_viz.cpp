@@ -0,0 +1,358 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include <plugin_api.h>
+#include <plugin_support.h>
+
+#include <spectrumengine.h>
+#include <spectrumoutput.h>
+
+#include "capture.h"
+
+#define PLUGIN_NAME "Audio Visualization Data"
+#define PLUGIN_CODE "linux_audio_viz"
+
+// Where samples come from, "fifo:<path>" or "wav:<path>"
+#define ENV_AUDIO_SOURCE "QUASAR_AUDIO_SOURCE"
+
+// Sample format of raw PCM, "s16le|f32le[:rate[:channels]]"
+#define ENV_AUDIO_FORMAT "QUASAR_AUDIO_FORMAT"
+
+#define VIZ_DEFAULT_SOURCE "fifo:/tmp/quasar-audio"
+#define VIZ_DEFAULT_FORMAT "s16le:44100:2"
+
+// Send at most this often, like every 10 WASAPI buffers on Windows
+#define VIZ_SEND_MSEC 50
+
+#define qlog(l, f, ...)                                                \
+    {                                                                  \
+        char msg[256];                                                 \
+        snprintf(msg, sizeof(msg), PLUGIN_CODE ": " f, ##__VA_ARGS__); \
+        quasar_log(l, msg);                                            \
+    }
+
+#define info(f, ...) qlog(QUASAR_LOG_INFO, f, ##__VA_ARGS__)
+#define warn(f, ...) qlog(QUASAR_LOG_WARNING, f, ##__VA_ARGS__)
+
+enum VizDataSources
+{
+    VIZ_SRC_SPECTRUM = 0,
+    VIZ_SRC_CHANNELS,
+    VIZ_SRC_LEVELS,
+    VIZ_SRC_WAVEFORM,
+    VIZ_SRC_BEAT
+};
+
+quasar_data_source_t sources[5] =
+    {
+        { "viz", -1, 0 },
+        { "viz_channels", -1, 0 },
+        { "levels", -1, 0 },
+        { "waveform", -1, 0 },
+        { "beat", -1, 0 }
+    };
+
+namespace
+{
+    quasar_plugin_handle plugHandle = nullptr;
+
+    std::unique_ptr<CaptureBackend> backend;
+    quasar_task_handle              hCaptureTask = nullptr;
+    int                             wakeFd       = -1;
+
+    size_t m_wavepoints = SPECTRUM_DEFAULT_WAVEFORM;
+
+    // Guarded by output.mutex()
+    SpectrumEngine engine;
+    SpectrumOutput output(engine);
+
+    uint64_t now_msec()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+}
+
+// Feeds whole frames to the engine, returns true if a new spectrum is ready to send
+static bool process(const char* data, size_t frames, bool& silent)
+{
+    std::unique_lock<std::shared_mutex> lock(output.mutex());
+
+    bool ready;
+
+    if (backend->format() == SAMPLE_F32LE)
+    {
+        ready = engine.pushFloat((const float*) data, frames);
+    }
+    else
+    {
+        ready = engine.pushInt16((const int16_t*) data, frames);
+    }
+
+    if (!ready)
+    {
+        return false;
+    }
+
+    silent = !output.update();
+
+    return true;
+}
+
+void CaptureTask(quasar_task_handle task, void* userdata)
+{
+    const size_t frameSize = backend->frameSize();
+
+    // Whole frames of ~20ms, and room for a partial frame left over from a read
+    std::vector<char> buf(std::max<size_t>(backend->rate() / 50, 1) * frameSize + frameSize);
+    size_t            have = 0;
+
+    uint64_t lastSend    = 0;
+    bool     sentOneZero = false;
+    bool     pending     = false;
+    bool     silent      = false;
+
+    while (!quasar_task_is_cancelled(task))
+    {
+        ssize_t n = backend->read(buf.data() + have, buf.size() - have, wakeFd);
+
+        // Woken up by shutdown() or failed
+        if (n <= 0)
+        {
+            break;
+        }
+
+        have += n;
+
+        size_t frames = have / frameSize;
+
+        if (frames)
+        {
+            bool frameSilent;
+
+            if (process(buf.data(), frames, frameSilent))
+            {
+                pending = true;
+                silent  = frameSilent;
+            }
+
+            // Keep the partial frame for the next read
+            have -= frames * frameSize;
+            memmove(buf.data(), buf.data() + frames * frameSize, have);
+        }
+
+        uint64_t now = now_msec();
+
+        if (pending && now - lastSend >= VIZ_SEND_MSEC)
+        {
+            // only send if not silent
+            if (!silent || !sentOneZero)
+            {
+                sentOneZero = silent;
+                output.sendAll(plugHandle, sources, std::size(sources));
+            }
+
+            lastSend = now;
+            pending  = false;
+        }
+    }
+
+    info("Audio capture task stopped");
+}
+
+void linux_audio_viz_cleanup()
+{
+    backend.reset();
+
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+
+    hCaptureTask = nullptr;
+}
+
+bool linux_audio_viz_init(quasar_plugin_handle handle)
+{
+    plugHandle = handle;
+
+    const char* source = getenv(ENV_AUDIO_SOURCE);
+    const char* format = getenv(ENV_AUDIO_FORMAT);
+
+    backend = CaptureBackend::create(source ? source : VIZ_DEFAULT_SOURCE, format ? format : VIZ_DEFAULT_FORMAT);
+
+    if (!backend || !backend->open())
+    {
+        linux_audio_viz_cleanup();
+        return false;
+    }
+
+    info("Capturing from %s, %s %u Hz, %u channels",
+         source ? source : VIZ_DEFAULT_SOURCE,
+         backend->format() == SAMPLE_F32LE ? "f32le" : "s16le",
+         backend->rate(),
+         backend->channels());
+
+    {
+        std::unique_lock<std::shared_mutex> lock(output.mutex());
+
+        engine.setFormat(backend->channels(), backend->rate());
+        output.reset();
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wakeFd < 0)
+    {
+        warn("eventfd failed: %s", strerror(errno));
+        linux_audio_viz_cleanup();
+        return false;
+    }
+
+    hCaptureTask = quasar_task_run_loop(handle, CaptureTask, nullptr, QUASAR_TASK_REALTIME);
+
+    if (nullptr == hCaptureTask)
+    {
+        warn("Failed to start audio capture task");
+        linux_audio_viz_cleanup();
+        return false;
+    }
+
+    return true;
+}
+
+bool linux_audio_viz_shutdown(quasar_plugin_handle handle)
+{
+    // The capture loop blocks on the backend rather than polling for cancellation
+    uint64_t one = 1;
+
+    if (write(wakeFd, &one, sizeof(one)) != sizeof(one))
+    {
+        warn("Failed to wake capture task: %s", strerror(errno));
+    }
+
+    quasar_task_wait(hCaptureTask);
+
+    linux_audio_viz_cleanup();
+
+    return true;
+}
+
+bool linux_audio_viz_get_data(size_t srcUid, quasar_data_handle hData)
+{
+    std::shared_lock<std::shared_mutex> lock(output.mutex());
+
+    if (srcUid == sources[VIZ_SRC_SPECTRUM].uid)
+    {
+        return output.sendSpectrum(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_CHANNELS].uid)
+    {
+        return output.sendChannels(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_LEVELS].uid)
+    {
+        return output.sendLevels(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_WAVEFORM].uid)
+    {
+        return output.sendWaveform(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_BEAT].uid)
+    {
+        return output.sendBeat(hData);
+    }
+
+    warn("Unknown source %zu", srcUid);
+
+    return false;
+}
+
+quasar_settings_t* linux_audio_viz_create_settings()
+{
+    quasar_settings_t* settings = quasar_create_settings();
+
+    quasar_add_int(settings, "fftsize", "FFT Size", 0, 8192, 2, 256);
+    quasar_add_double(settings, "sensitivity", "Sensitivity", 0.0, 10000.0, 0.1, 50.0);
+    quasar_add_double(settings, "freqmin", "Band Frequency Min (Hz)", 0.0, 20000.0, 0.1, 20.0);
+    quasar_add_double(settings, "freqmax", "Band Frequency Band Max (Hz)", 0.0, 20000.0, 0.1, 20000.0);
+    quasar_add_int(settings, "numbands", "Number of Bands", 0, 1024, 1, 32);
+    quasar_add_int(settings, "wavepoints", "Waveform Points", 1, 8192, 1, SPECTRUM_DEFAULT_WAVEFORM);
+
+    return settings;
+}
+
+void linux_audio_viz_update_settings(quasar_settings_t* settings)
+{
+    size_t fftsize     = quasar_get_uint(settings, "fftsize");
+    double sensitivity = quasar_get_double(settings, "sensitivity");
+    double freqmin     = quasar_get_double(settings, "freqmin");
+    double freqmax     = quasar_get_double(settings, "freqmax");
+    size_t numbands    = quasar_get_uint(settings, "numbands");
+    size_t wavepoints  = quasar_get_uint(settings, "wavepoints");
+
+    std::unique_lock<std::shared_mutex> lock(output.mutex());
+
+    output.setSensitivity(sensitivity);
+
+    if (wavepoints != m_wavepoints)
+    {
+        m_wavepoints = wavepoints;
+        engine.setWaveformSize(wavepoints);
+    }
+
+    if (fftsize != engine.fftSize())
+    {
+        engine.setFftSize(fftsize);
+    }
+
+    if (numbands != engine.numBands() || freqmin != engine.freqMin() || freqmax != engine.freqMax())
+    {
+        engine.setBands(numbands, freqmin, freqmax);
+        output.reset();
+    }
+}
+
+quasar_plugin_info_t info =
+    {
+        QUASAR_API_VERSION,
+        PLUGIN_NAME,
+        PLUGIN_CODE,
+        "v1",
+        "me",
+        "Supplies audio spectrum, level, waveform and beat data from a pipe or WAV file",
+
+        std::size(sources),
+        sources,
+
+        linux_audio_viz_init,
+        linux_audio_viz_shutdown,
+        linux_audio_viz_get_data,
+        linux_audio_viz_create_settings,
+        linux_audio_viz_update_settings,
+        nullptr
+    };
+
+quasar_plugin_info_t* quasar_plugin_load(void)
+{
+    return &info;
+}
+
+void quasar_plugin_destroy(quasar_plugin_info_t* info)
+{
+    // does nothing; info is static
+}
@@ -0,0 +1,759 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <plugin_api.h>
+#include <plugin_support.h>
+
+#define PLUGIN_NAME "Linux File Watch"
+#define PLUGIN_CODE "linux_filewatch"
+
+#define qlog(l, f, ...)                                                \
+    {                                                                  \
+        char msg[256];                                                 \
+        snprintf(msg, sizeof(msg), PLUGIN_CODE ": " f, ##__VA_ARGS__); \
+        quasar_log(l, msg);                                            \
+    }
+
+#define info(f, ...) qlog(QUASAR_LOG_INFO, f, ##__VA_ARGS__)
+#define warn(f, ...) qlog(QUASAR_LOG_WARNING, f, ##__VA_ARGS__)
+
+// ':' separated lists of files to tail and directories to watch
+#define ENV_TAIL_FILES  "QUASAR_TAIL_FILES"
+#define ENV_WATCH_DIRS  "QUASAR_WATCH_DIRS"
+
+// A line longer than this is sent in pieces
+#define TAIL_MAX_LINE 65536
+
+// Oldest entries are dropped past these if nobody fetches them
+#define TAIL_MAX_PENDING_LINES  4096
+#define WATCH_MAX_PENDING_EVENTS 4096
+
+enum WatchDataSources
+{
+    WATCH_SRC_TAIL = 0,
+    WATCH_SRC_WATCH
+};
+
+quasar_data_source_t sources[2] =
+    {
+        { "tail", -1, 0 },
+        { "watch", -1, 0 }
+    };
+
+struct TailFile
+{
+    std::string path;
+    std::string name; // file name within its directory
+    int         fd     = -1;
+    int         wd     = -1;
+    ino_t       inode  = 0;
+    off_t       offset = 0;
+    std::string partial; // bytes after the last newline
+
+    std::deque<std::string> pending;
+};
+
+struct WatchDir
+{
+    std::string            path;
+    bool                   report = false; // a configured watch directory
+    std::vector<TailFile*> tails;          // tailed files living in it
+};
+
+struct WatchEvent
+{
+    std::string dir;
+    std::string name;
+    const char* event;
+};
+
+static quasar_plugin_handle pluginHandle;
+static quasar_task_handle   watchTask;
+
+static int inotifyFd = -1;
+static int wakeFd    = -1;
+
+static std::vector<std::unique_ptr<TailFile>> tails;
+static std::unordered_map<int, WatchDir>      dirWatches;  // by watch descriptor
+static std::unordered_map<int, TailFile*>     fileWatches; // by watch descriptor
+
+// Guards the pending lines and events, shared with get_data
+static std::mutex             pendingMutex;
+static std::deque<WatchEvent> pendingEvents;
+static bool                   tailSignaled;
+static bool                   watchSignaled;
+
+static std::vector<char> readBuffer;
+
+static std::vector<std::string> split_paths(const char* env)
+{
+    std::vector<std::string> out;
+    const char*              val = getenv(env);
+
+    if (!val)
+    {
+        return out;
+    }
+
+    std::string s(val);
+    size_t      start = 0;
+
+    while (start <= s.size())
+    {
+        size_t end = s.find(':', start);
+
+        if (end == std::string::npos)
+        {
+            end = s.size();
+        }
+
+        if (end > start)
+        {
+            out.push_back(s.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return out;
+}
+
+static void split_dir(const std::string& path, std::string& dir, std::string& name)
+{
+    size_t slash = path.rfind('/');
+
+    if (slash == std::string::npos)
+    {
+        dir  = ".";
+        name = path;
+    }
+    else
+    {
+        dir  = slash ? path.substr(0, slash) : "/";
+        name = path.substr(slash + 1);
+    }
+}
+
+static int add_dir_watch(const std::string& dir)
+{
+    // IN_MASK_ADD as a tailed file's directory may also be watched for itself
+    int wd = inotify_add_watch(inotifyFd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MASK_ADD | IN_ONLYDIR);
+
+    if (wd < 0)
+    {
+        warn("Failed to watch %s: %s", dir.c_str(), strerror(errno));
+        return -1;
+    }
+
+    dirWatches[wd].path = dir;
+    return wd;
+}
+
+// Splits new bytes into lines, keeping an incomplete last line for later
+static size_t push_bytes(TailFile& tf, const char* data, size_t len, std::deque<std::string>& lines)
+{
+    size_t      count = 0;
+    const char* end   = data + len;
+
+    while (data < end)
+    {
+        const char* nl = (const char*) memchr(data, '\n', end - data);
+
+        if (!nl)
+        {
+            tf.partial.append(data, end - data);
+
+            if (tf.partial.size() >= TAIL_MAX_LINE)
+            {
+                lines.push_back(std::move(tf.partial));
+                tf.partial.clear();
+                count++;
+            }
+
+            break;
+        }
+
+        tf.partial.append(data, nl - data);
+
+        if (!tf.partial.empty() && tf.partial.back() == '\r')
+        {
+            tf.partial.pop_back();
+        }
+
+        lines.push_back(std::move(tf.partial));
+        tf.partial.clear();
+        count++;
+
+        data = nl + 1;
+    }
+
+    return count;
+}
+
+// Reads what was appended since the last read, returns the number of new lines
+static size_t read_appended(TailFile& tf)
+{
+    if (tf.fd < 0)
+    {
+        return 0;
+    }
+
+    struct stat st;
+
+    if (fstat(tf.fd, &st) != 0)
+    {
+        return 0;
+    }
+
+    if (st.st_size < tf.offset)
+    {
+        // Truncated in place, start over
+        tf.offset = 0;
+        tf.partial.clear();
+    }
+
+    size_t len = st.st_size - tf.offset;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    std::deque<std::string> lines;
+
+    // Copied out in chunks rather than mapped: a file truncated under a mapping
+    // (logrotate copytruncate) raises SIGBUS, while pread just comes up short
+    while (len)
+    {
+        ssize_t n = pread(tf.fd, readBuffer.data(), std::min(len, readBuffer.size()), tf.offset);
+
+        if (n <= 0)
+        {
+            break;
+        }
+
+        push_bytes(tf, readBuffer.data(), n, lines);
+
+        tf.offset += n;
+        len -= n;
+    }
+
+    if (lines.empty())
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lk(pendingMutex);
+
+    size_t count = lines.size();
+
+    for (auto& l : lines)
+    {
+        tf.pending.push_back(std::move(l));
+    }
+
+    while (tf.pending.size() > TAIL_MAX_PENDING_LINES)
+    {
+        tf.pending.pop_front();
+    }
+
+    return count;
+}
+
+// (Re)opens a tailed file. Only lines appended from now on are sent, except for a
+// file that replaced a rotated one, which is read from the start.
+// Returns the number of lines left in the file being replaced
+static size_t open_tail(TailFile& tf, bool fromStart)
+{
+    size_t count = 0;
+
+    if (tf.fd >= 0)
+    {
+        // Whatever was appended to the old file before it was replaced
+        count = read_appended(tf);
+
+        close(tf.fd);
+        tf.fd = -1;
+    }
+
+    if (tf.wd >= 0)
+    {
+        inotify_rm_watch(inotifyFd, tf.wd);
+        fileWatches.erase(tf.wd);
+        tf.wd = -1;
+    }
+
+    tf.partial.clear();
+    tf.offset = 0;
+
+    int fd = open(tf.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        // Not there yet, the directory watch reports when it is
+        return count;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        warn("%s is not a regular file", tf.path.c_str());
+        close(fd);
+        return count;
+    }
+
+    tf.wd = inotify_add_watch(inotifyFd, tf.path.c_str(), IN_MODIFY);
+
+    if (tf.wd < 0)
+    {
+        warn("Failed to watch %s: %s", tf.path.c_str(), strerror(errno));
+        close(fd);
+        return count;
+    }
+
+    fileWatches[tf.wd] = &tf;
+
+    tf.fd     = fd;
+    tf.inode  = st.st_ino;
+    tf.offset = fromStart ? 0 : st.st_size;
+
+    return count;
+}
+
+static void queue_event(const std::string& dir, const char* name, const char* event)
+{
+    std::lock_guard<std::mutex> lk(pendingMutex);
+
+    pendingEvents.push_back({ dir, name, event });
+
+    while (pendingEvents.size() > WATCH_MAX_PENDING_EVENTS)
+    {
+        pendingEvents.pop_front();
+    }
+}
+
+static const char* event_name(uint32_t mask)
+{
+    if (mask & IN_CREATE)
+        return "created";
+    if (mask & IN_DELETE)
+        return "deleted";
+    if (mask & IN_MOVED_FROM)
+        return "moved_from";
+    if (mask & IN_MOVED_TO)
+        return "moved_to";
+    if (mask & IN_CLOSE_WRITE)
+        return "modified";
+
+    return nullptr;
+}
+
+// Handles one inotify event, sets the sources that have something new
+static void handle_event(const inotify_event* ev, bool& tailReady, bool& watchReady)
+{
+    if (ev->mask & IN_Q_OVERFLOW)
+    {
+        // Events were lost, catch up on every file and let watchers rescan
+        warn("inotify queue overflowed");
+
+        for (auto& tf : tails)
+        {
+            if (tf->fd < 0 && open_tail(*tf, true))
+            {
+                tailReady = true;
+            }
+
+            tailReady = read_appended(*tf) || tailReady;
+        }
+
+        for (auto& it : dirWatches)
+        {
+            if (it.second.report)
+            {
+                queue_event(it.second.path, "", "overflow");
+                watchReady = true;
+            }
+        }
+
+        return;
+    }
+
+    auto fit = fileWatches.find(ev->wd);
+
+    if (fit != fileWatches.end())
+    {
+        if (ev->mask & IN_MODIFY)
+        {
+            tailReady = read_appended(*fit->second) || tailReady;
+        }
+        else if (ev->mask & IN_IGNORED)
+        {
+            // File is gone and its watch with it
+            fit->second->wd = -1;
+            fileWatches.erase(fit);
+        }
+
+        return;
+    }
+
+    auto dit = dirWatches.find(ev->wd);
+
+    if (dit == dirWatches.end() || !ev->len)
+    {
+        return;
+    }
+
+    WatchDir& wdir = dit->second;
+
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+    {
+        // A tailed file was created or rotated in
+        for (TailFile* tf : wdir.tails)
+        {
+            if (tf->name == ev->name)
+            {
+                struct stat st;
+
+                if (tf->fd < 0 || (stat(tf->path.c_str(), &st) == 0 && st.st_ino != tf->inode))
+                {
+                    size_t count = open_tail(*tf, true);
+                    count += read_appended(*tf);
+
+                    tailReady = count || tailReady;
+                }
+            }
+        }
+    }
+
+    if (wdir.report)
+    {
+        if (const char* name = event_name(ev->mask))
+        {
+            queue_event(wdir.path, ev->name, name);
+            watchReady = true;
+        }
+    }
+}
+
+static void signal_ready(bool& signaled, const char* source)
+{
+    bool signal;
+
+    {
+        std::lock_guard<std::mutex> lk(pendingMutex);
+
+        // One signal until the data is fetched, later data rides along with it
+        signal   = !signaled;
+        signaled = true;
+    }
+
+    if (signal)
+    {
+        quasar_signal_data_ready(pluginHandle, source);
+    }
+}
+
+static void WatchTask(quasar_task_handle task, void*)
+{
+    alignas(inotify_event) char buf[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+
+    pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+
+    // Blocks until something changes or shutdown() wakes the task, there is no timeout
+    while (!quasar_task_is_cancelled(task))
+    {
+        if (poll(fds, std::size(fds), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            warn("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents)
+        {
+            break;
+        }
+
+        ssize_t n = read(inotifyFd, buf, sizeof(buf));
+
+        if (n <= 0)
+        {
+            continue;
+        }
+
+        bool tailReady  = false;
+        bool watchReady = false;
+
+        for (char* p = buf; p < buf + n;)
+        {
+            const inotify_event* ev = (const inotify_event*) p;
+
+            handle_event(ev, tailReady, watchReady);
+
+            p += sizeof(inotify_event) + ev->len;
+        }
+
+        if (tailReady)
+        {
+            signal_ready(tailSignaled, sources[WATCH_SRC_TAIL].dataSrc);
+        }
+
+        if (watchReady)
+        {
+            signal_ready(watchSignaled, sources[WATCH_SRC_WATCH].dataSrc);
+        }
+    }
+}
+
+static void cleanup()
+{
+    for (auto& tf : tails)
+    {
+        if (tf->fd >= 0)
+        {
+            close(tf->fd);
+        }
+    }
+
+    tails.clear();
+    dirWatches.clear();
+    fileWatches.clear();
+    pendingEvents.clear();
+    readBuffer.clear();
+    readBuffer.shrink_to_fit();
+
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+}
+
+bool file_watch_init(quasar_plugin_handle handle)
+{
+    pluginHandle = handle;
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (inotifyFd < 0 || wakeFd < 0)
+    {
+        warn("Failed to create inotify instance: %s", strerror(errno));
+        cleanup();
+        return false;
+    }
+
+    readBuffer.resize(64 * 1024);
+
+    for (const std::string& path : split_paths(ENV_TAIL_FILES))
+    {
+        bool dup = false;
+
+        for (auto& tf : tails)
+        {
+            dup = dup || tf->path == path;
+        }
+
+        if (dup)
+        {
+            continue;
+        }
+
+        auto tf  = std::make_unique<TailFile>();
+        tf->path = path;
+
+        std::string dir;
+        split_dir(path, dir, tf->name);
+
+        // The directory watch catches creation and rotation of the file
+        int wd = add_dir_watch(dir);
+
+        if (wd < 0)
+        {
+            continue;
+        }
+
+        dirWatches[wd].tails.push_back(tf.get());
+
+        open_tail(*tf, false);
+
+        info("Tailing %s", path.c_str());
+        tails.push_back(std::move(tf));
+    }
+
+    for (const std::string& path : split_paths(ENV_WATCH_DIRS))
+    {
+        int wd = add_dir_watch(path);
+
+        if (wd >= 0)
+        {
+            dirWatches[wd].report = true;
+            info("Watching %s", path.c_str());
+        }
+    }
+
+    if (tails.empty() && dirWatches.empty())
+    {
+        info("Nothing to watch, set " ENV_TAIL_FILES " and/or " ENV_WATCH_DIRS);
+    }
+
+    watchTask = quasar_task_run_loop(handle, WatchTask, nullptr, QUASAR_TASK_NONE);
+
+    if (!watchTask)
+    {
+        warn("Failed to start watch task");
+        cleanup();
+        return false;
+    }
+
+    return true;
+}
+
+bool file_watch_shutdown(quasar_plugin_handle handle)
+{
+    // The task sleeps in poll() rather than checking for cancellation, wake it
+    uint64_t one = 1;
+
+    if (write(wakeFd, &one, sizeof(one)) != sizeof(one))
+    {
+        warn("Failed to wake watch task: %s", strerror(errno));
+    }
+
+    quasar_task_wait(watchTask);
+    watchTask = nullptr;
+
+    cleanup();
+
+    return true;
+}
+
+// {"<path>": ["line", ...], ...} with the lines appended since the last fetch
+static bool send_tail(quasar_data_handle hData)
+{
+    std::lock_guard<std::mutex> lk(pendingMutex);
+
+    quasar_data_begin_object(hData, nullptr);
+
+    for (auto& tf : tails)
+    {
+        if (tf->pending.empty())
+        {
+            continue;
+        }
+
+        quasar_data_begin_array(hData, tf->path.c_str());
+
+        for (const std::string& line : tf->pending)
+        {
+            quasar_data_add_string(hData, nullptr, line.c_str());
+        }
+
+        quasar_data_end_array(hData);
+
+        tf->pending.clear();
+    }
+
+    quasar_data_end_object(hData);
+
+    tailSignaled = false;
+
+    return true;
+}
+
+// [{"dir": ..., "name": ..., "event": ...}, ...] since the last fetch
+static bool send_watch(quasar_data_handle hData)
+{
+    std::lock_guard<std::mutex> lk(pendingMutex);
+
+    quasar_data_begin_array(hData, nullptr);
+
+    for (const WatchEvent& ev : pendingEvents)
+    {
+        quasar_data_begin_object(hData, nullptr);
+        quasar_data_add_string(hData, "dir", ev.dir.c_str());
+        quasar_data_add_string(hData, "name", ev.name.c_str());
+        quasar_data_add_string(hData, "event", ev.event);
+        quasar_data_end_object(hData);
+    }
+
+    quasar_data_end_array(hData);
+
+    pendingEvents.clear();
+    watchSignaled = false;
+
+    return true;
+}
+
+bool file_watch_get_data(size_t srcUid, quasar_data_handle hData)
+{
+    if (srcUid == sources[WATCH_SRC_TAIL].uid)
+    {
+        return send_tail(hData);
+    }
+    else if (srcUid == sources[WATCH_SRC_WATCH].uid)
+    {
+        return send_watch(hData);
+    }
+
+    warn("Unknown source %zu", srcUid);
+    return false;
+}
+
+quasar_plugin_info_t info =
+    {
+        QUASAR_API_VERSION,
+        PLUGIN_NAME,
+        PLUGIN_CODE,
+        "v1",
+        "me",
+        "Tails log files and watches directories for changes",
+
+        std::size(sources),
+        sources,
+
+        file_watch_init,
+        file_watch_shutdown,
+        file_watch_get_data,
+        nullptr,
+        nullptr,
+        nullptr
+    };
+
+quasar_plugin_info_t* quasar_plugin_load(void)
+{
+    return &info;
+}
+
+void quasar_plugin_destroy(quasar_plugin_info_t* info)
+{
+    // does nothing; info is static
+}
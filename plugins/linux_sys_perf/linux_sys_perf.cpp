@@ -0,0 +1,770 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+
+#include <plugin_api.h>
+#include <plugin_support.h>
+
+#define PLUGIN_NAME "Linux System Performance"
+#define PLUGIN_CODE "linux_sys_perf"
+
+#define qlog(l, f, ...)                                                \
+    {                                                                  \
+        char msg[256];                                                 \
+        snprintf(msg, sizeof(msg), PLUGIN_CODE ": " f, ##__VA_ARGS__); \
+        quasar_log(l, msg);                                            \
+    }
+
+#define info(f, ...) qlog(QUASAR_LOG_INFO, f, ##__VA_ARGS__)
+#define warn(f, ...) qlog(QUASAR_LOG_WARNING, f, ##__VA_ARGS__)
+
+// Entries past these limits are ignored
+#define MAX_CPUS 256
+#define MAX_IFACES 32
+#define MAX_DISKS 64
+#define NAME_LEN 32
+
+// A /proc file read more recently than this is reused, so sources
+// refreshed in the same tick share one snapshot
+#define SNAPSHOT_MAX_AGE_MS 50
+
+using GetDataFnType = std::function<bool(quasar_data_handle hData)>;
+using DataCallTable = std::unordered_map<size_t, GetDataFnType>;
+
+static DataCallTable calltable;
+
+enum PerfDataSources
+{
+    PERF_SRC_CPU = 0,
+    PERF_SRC_CPUS,
+    PERF_SRC_RAM,
+    PERF_SRC_NET,
+    PERF_SRC_DISK,
+    PERF_SRC_LOAD
+};
+
+quasar_data_source_t sources[6] =
+    {
+        { "cpu", 1000, 0 },
+        { "cpus", 1000, 0 },
+        { "ram", 5000, 0 },
+        { "net", 1000, 0 },
+        { "disk", 1000, 0 },
+        { "load", 5000, 0 }
+    };
+
+// /proc files, kept open and read in place
+enum ProcFiles
+{
+    PROC_STAT = 0,
+    PROC_MEMINFO,
+    PROC_NETDEV,
+    PROC_DISKSTATS,
+    PROC_LOADAVG,
+    PROC_COUNT
+};
+
+static char statbuf[32768];
+static char meminfobuf[8192];
+static char netdevbuf[16384];
+static char diskstatsbuf[32768];
+static char loadavgbuf[256];
+
+struct ProcFile
+{
+    const char* path;
+    char*       buf;
+    size_t      cap;
+    int         fd;
+    uint64_t    msec; // when last read
+};
+
+static ProcFile procfiles[PROC_COUNT] =
+    {
+        { "/proc/stat", statbuf, sizeof(statbuf), -1, 0 },
+        { "/proc/meminfo", meminfobuf, sizeof(meminfobuf), -1, 0 },
+        { "/proc/net/dev", netdevbuf, sizeof(netdevbuf), -1, 0 },
+        { "/proc/diskstats", diskstatsbuf, sizeof(diskstatsbuf), -1, 0 },
+        { "/proc/loadavg", loadavgbuf, sizeof(loadavgbuf), -1, 0 }
+    };
+
+// Minimal cursor over a NUL terminated buffer
+struct Parser
+{
+    const char* p;
+
+    bool eof() const { return *p == 0; }
+
+    void skipSpaces()
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+    }
+
+    void nextLine()
+    {
+        while (*p && *p != '\n')
+            p++;
+
+        if (*p)
+            p++;
+    }
+
+    bool startsWith(const char* s, size_t len) const { return strncmp(p, s, len) == 0; }
+
+    uint64_t u64()
+    {
+        uint64_t v = 0;
+
+        skipSpaces();
+
+        while (*p >= '0' && *p <= '9')
+            v = v * 10 + (*p++ - '0');
+
+        return v;
+    }
+
+    double decimal()
+    {
+        double v = (double) u64();
+
+        if (*p == '.')
+        {
+            double scale = 0.1;
+
+            for (p++; *p >= '0' && *p <= '9'; p++, scale *= 0.1)
+                v += (*p - '0') * scale;
+        }
+
+        return v;
+    }
+
+    // Copies a token ending at whitespace or delim, consuming delim
+    void word(char* out, size_t cap, char delim)
+    {
+        size_t n = 0;
+
+        skipSpaces();
+
+        while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != delim)
+        {
+            if (n + 1 < cap)
+                out[n++] = *p;
+
+            p++;
+        }
+
+        out[n] = 0;
+
+        if (*p == delim)
+            p++;
+    }
+};
+
+struct CpuTimes
+{
+    uint64_t busy;
+    uint64_t total;
+};
+
+struct CpuSnapshot
+{
+    CpuTimes all;
+    CpuTimes cores[MAX_CPUS];
+    int      ncores;
+};
+
+struct IfaceCounters
+{
+    char     name[NAME_LEN];
+    uint64_t rx; // bytes
+    uint64_t tx;
+};
+
+struct NetSnapshot
+{
+    IfaceCounters ifaces[MAX_IFACES];
+    int           count;
+};
+
+struct DiskCounters
+{
+    char     name[NAME_LEN];
+    uint64_t read; // sectors
+    uint64_t written;
+};
+
+struct DiskSnapshot
+{
+    DiskCounters disks[MAX_DISKS];
+    int          count;
+};
+
+// Latest two readings of counters as seen by one source, rates are taken between
+// them. Every source keeps its own, so its rates cover its own refresh interval
+// even when another source reads the same file in between
+template <typename T>
+struct Sampled
+{
+    T        samples[2];
+    uint64_t msec[2] = { 0, 0 };
+    int      cur     = 0;
+
+    // Takes the latest reading unless it is the one taken last
+    void update(const T& latest, uint64_t now)
+    {
+        if (now != msec[cur])
+        {
+            cur ^= 1;
+            msec[cur]    = now;
+            samples[cur] = latest;
+        }
+    }
+
+    const T& current() const { return samples[cur]; }
+    const T& previous() const { return samples[cur ^ 1]; }
+    uint64_t elapsed() const { return msec[cur ^ 1] ? msec[cur] - msec[cur ^ 1] : 0; }
+};
+
+// Latest readings, shared by the sources reading the same file
+static CpuSnapshot  cpusnap;
+static NetSnapshot  netsnap;
+static DiskSnapshot disksnap;
+
+// Per source
+static Sampled<CpuTimes>     cpu;
+static Sampled<CpuSnapshot>  cores;
+static Sampled<NetSnapshot>  net;
+static Sampled<DiskSnapshot> disk;
+
+static uint64_t memtotal, memavailable, swaptotal, swapfree;
+static double   loadavg[3];
+
+// Whole disks seen so far, partitions and virtual devices are skipped
+struct DiskName
+{
+    char name[NAME_LEN];
+    bool whole;
+};
+
+static DiskName diskcache[MAX_DISKS * 2];
+static int      ndiskcache;
+
+static uint64_t now_msec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool read_proc(ProcFile& f)
+{
+    size_t len = 0;
+
+    if (f.fd < 0)
+    {
+        return false;
+    }
+
+    // procfs regenerates the contents when read from offset 0
+    while (len < f.cap - 1)
+    {
+        ssize_t n = pread(f.fd, f.buf + len, f.cap - 1 - len, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            break;
+
+        len += n;
+    }
+
+    f.buf[len] = 0;
+
+    return len > 0;
+}
+
+static void parse_stat()
+{
+    CpuSnapshot& snap = cpusnap;
+    Parser       ps{ statbuf };
+
+    snap.ncores = 0;
+
+    // cpu lines come first
+    while (!ps.eof() && ps.startsWith("cpu", 3))
+    {
+        bool all = (ps.p[3] == ' ');
+
+        ps.p += 3;
+
+        if (!all)
+        {
+            ps.u64();
+        }
+
+        // user nice system idle iowait irq softirq steal, guest time is part of user
+        uint64_t f[8];
+
+        for (int i = 0; i < 8; i++)
+        {
+            f[i] = ps.u64();
+        }
+
+        CpuTimes t;
+        t.total = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7];
+        t.busy  = t.total - f[3] - f[4];
+
+        if (all)
+        {
+            snap.all = t;
+        }
+        else if (snap.ncores < MAX_CPUS)
+        {
+            snap.cores[snap.ncores++] = t;
+        }
+
+        ps.nextLine();
+    }
+}
+
+static void parse_meminfo()
+{
+    Parser ps{ meminfobuf };
+    char   key[NAME_LEN];
+    int    found = 0;
+
+    while (!ps.eof() && found < 4)
+    {
+        ps.word(key, sizeof(key), ':');
+
+        uint64_t val = ps.u64() * 1024;
+
+        if (!strcmp(key, "MemTotal"))
+            memtotal = val, found++;
+        else if (!strcmp(key, "MemAvailable"))
+            memavailable = val, found++;
+        else if (!strcmp(key, "SwapTotal"))
+            swaptotal = val, found++;
+        else if (!strcmp(key, "SwapFree"))
+            swapfree = val, found++;
+
+        ps.nextLine();
+    }
+}
+
+static void parse_netdev()
+{
+    NetSnapshot& snap = netsnap;
+    Parser       ps{ netdevbuf };
+
+    snap.count = 0;
+
+    // two header lines
+    ps.nextLine();
+    ps.nextLine();
+
+    while (!ps.eof() && snap.count < MAX_IFACES)
+    {
+        IfaceCounters& c = snap.ifaces[snap.count];
+
+        ps.word(c.name, sizeof(c.name), ':');
+
+        // rx bytes packets errs drop fifo frame compressed multicast, then tx bytes
+        c.rx = ps.u64();
+
+        for (int i = 0; i < 7; i++)
+        {
+            ps.u64();
+        }
+
+        c.tx = ps.u64();
+
+        if (c.name[0] && strcmp(c.name, "lo"))
+        {
+            snap.count++;
+        }
+
+        ps.nextLine();
+    }
+}
+
+static bool is_whole_disk(const char* name)
+{
+    for (int i = 0; i < ndiskcache; i++)
+    {
+        if (!strcmp(diskcache[i].name, name))
+        {
+            return diskcache[i].whole;
+        }
+    }
+
+    // Only looked up the first time a device shows up
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/block/%s", name);
+
+    struct stat st;
+    bool        whole = (stat(path, &st) == 0) && strncmp(name, "loop", 4) && strncmp(name, "ram", 3) && strncmp(name, "zram", 4);
+
+    if (ndiskcache < (int) (sizeof(diskcache) / sizeof(diskcache[0])))
+    {
+        strcpy(diskcache[ndiskcache].name, name);
+        diskcache[ndiskcache].whole = whole;
+        ndiskcache++;
+    }
+
+    return whole;
+}
+
+static void parse_diskstats()
+{
+    DiskSnapshot& snap = disksnap;
+    Parser        ps{ diskstatsbuf };
+
+    snap.count = 0;
+
+    while (!ps.eof() && snap.count < MAX_DISKS)
+    {
+        DiskCounters& c = snap.disks[snap.count];
+
+        // major minor name reads merged sectors_read ms writes merged sectors_written
+        ps.u64();
+        ps.u64();
+        ps.word(c.name, sizeof(c.name), ' ');
+
+        ps.u64();
+        ps.u64();
+        c.read = ps.u64();
+        ps.u64();
+        ps.u64();
+        ps.u64();
+        c.written = ps.u64();
+
+        if (c.name[0] && is_whole_disk(c.name))
+        {
+            snap.count++;
+        }
+
+        ps.nextLine();
+    }
+}
+
+static void parse_loadavg()
+{
+    Parser ps{ loadavgbuf };
+
+    for (int i = 0; i < 3; i++)
+    {
+        ps.skipSpaces();
+        loadavg[i] = ps.decimal();
+    }
+}
+
+// Re-reads the files behind the given sources unless they are fresh
+static void snapshot(unsigned files)
+{
+    static void (*const parsers[PROC_COUNT])() = { parse_stat, parse_meminfo, parse_netdev, parse_diskstats, parse_loadavg };
+
+    uint64_t now = now_msec();
+
+    for (int i = 0; i < PROC_COUNT; i++)
+    {
+        ProcFile& f = procfiles[i];
+
+        if ((files & (1u << i)) && (f.msec == 0 || now - f.msec >= SNAPSHOT_MAX_AGE_MS))
+        {
+            if (read_proc(f))
+            {
+                f.msec = now;
+                parsers[i]();
+            }
+        }
+    }
+}
+
+static unsigned files_for(size_t srcUid)
+{
+    if (srcUid == sources[PERF_SRC_CPU].uid || srcUid == sources[PERF_SRC_CPUS].uid)
+        return 1u << PROC_STAT;
+    if (srcUid == sources[PERF_SRC_RAM].uid)
+        return 1u << PROC_MEMINFO;
+    if (srcUid == sources[PERF_SRC_NET].uid)
+        return 1u << PROC_NETDEV;
+    if (srcUid == sources[PERF_SRC_DISK].uid)
+        return 1u << PROC_DISKSTATS;
+    if (srcUid == sources[PERF_SRC_LOAD].uid)
+        return 1u << PROC_LOADAVG;
+
+    return 0;
+}
+
+static double percent(const CpuTimes& now, const CpuTimes& prev)
+{
+    uint64_t total = now.total - prev.total;
+    uint64_t busy  = now.busy - prev.busy;
+
+    if (now.total <= prev.total || now.busy < prev.busy)
+    {
+        return 0.0;
+    }
+
+    return std::round(1000.0 * busy / total) / 10.0;
+}
+
+static double per_second(uint64_t now, uint64_t prev, uint64_t elapsedMsec)
+{
+    return (elapsedMsec && now >= prev) ? (now - prev) * 1000.0 / elapsedMsec : 0.0;
+}
+
+bool getCPUData(quasar_data_handle hData)
+{
+    cpu.update(cpusnap.all, procfiles[PROC_STAT].msec);
+
+    quasar_data_add_double(hData, nullptr, percent(cpu.current(), cpu.previous()));
+
+    return true;
+}
+
+bool getCoresData(quasar_data_handle hData)
+{
+    cores.update(cpusnap, procfiles[PROC_STAT].msec);
+
+    const CpuSnapshot& now  = cores.current();
+    const CpuSnapshot& prev = cores.previous();
+
+    quasar_data_begin_array(hData, nullptr);
+
+    for (int i = 0; i < now.ncores; i++)
+    {
+        quasar_data_add_double(hData, nullptr, (i < prev.ncores) ? percent(now.cores[i], prev.cores[i]) : 0.0);
+    }
+
+    quasar_data_end_array(hData);
+
+    return true;
+}
+
+bool getRAMData(quasar_data_handle hData)
+{
+    quasar_data_begin_object(hData, nullptr);
+    quasar_data_add_int(hData, "total", memtotal);
+    quasar_data_add_int(hData, "used", memtotal - memavailable);
+    quasar_data_add_int(hData, "swaptotal", swaptotal);
+    quasar_data_add_int(hData, "swapused", swaptotal - swapfree);
+    quasar_data_end_object(hData);
+
+    return true;
+}
+
+bool getNetData(quasar_data_handle hData)
+{
+    net.update(netsnap, procfiles[PROC_NETDEV].msec);
+
+    const NetSnapshot& now  = net.current();
+    const NetSnapshot& prev = net.previous();
+    uint64_t           ms   = net.elapsed();
+
+    quasar_data_begin_object(hData, nullptr);
+
+    for (int i = 0; i < now.count; i++)
+    {
+        const IfaceCounters& c = now.ifaces[i];
+
+        // Interfaces rarely change, so the same slot usually matches
+        const IfaceCounters* p = (i < prev.count && !strcmp(prev.ifaces[i].name, c.name)) ? &prev.ifaces[i] : nullptr;
+
+        for (int j = 0; !p && j < prev.count; j++)
+        {
+            if (!strcmp(prev.ifaces[j].name, c.name))
+                p = &prev.ifaces[j];
+        }
+
+        quasar_data_begin_object(hData, c.name);
+        quasar_data_add_double(hData, "rx", p ? per_second(c.rx, p->rx, ms) : 0.0);
+        quasar_data_add_double(hData, "tx", p ? per_second(c.tx, p->tx, ms) : 0.0);
+        quasar_data_end_object(hData);
+    }
+
+    quasar_data_end_object(hData);
+
+    return true;
+}
+
+bool getDiskData(quasar_data_handle hData)
+{
+    disk.update(disksnap, procfiles[PROC_DISKSTATS].msec);
+
+    const DiskSnapshot& now  = disk.current();
+    const DiskSnapshot& prev = disk.previous();
+    uint64_t            ms   = disk.elapsed();
+
+    quasar_data_begin_object(hData, nullptr);
+
+    for (int i = 0; i < now.count; i++)
+    {
+        const DiskCounters& c = now.disks[i];
+        const DiskCounters* p = (i < prev.count && !strcmp(prev.disks[i].name, c.name)) ? &prev.disks[i] : nullptr;
+
+        for (int j = 0; !p && j < prev.count; j++)
+        {
+            if (!strcmp(prev.disks[j].name, c.name))
+                p = &prev.disks[j];
+        }
+
+        // diskstats counts 512 byte sectors regardless of the device
+        quasar_data_begin_object(hData, c.name);
+        quasar_data_add_double(hData, "read", p ? per_second(c.read, p->read, ms) * 512 : 0.0);
+        quasar_data_add_double(hData, "write", p ? per_second(c.written, p->written, ms) * 512 : 0.0);
+        quasar_data_end_object(hData);
+    }
+
+    quasar_data_end_object(hData);
+
+    return true;
+}
+
+bool getLoadData(quasar_data_handle hData)
+{
+    quasar_data_begin_object(hData, nullptr);
+    quasar_data_add_double(hData, "1m", loadavg[0]);
+    quasar_data_add_double(hData, "5m", loadavg[1]);
+    quasar_data_add_double(hData, "15m", loadavg[2]);
+    quasar_data_end_object(hData);
+
+    return true;
+}
+
+bool sys_perf_init(quasar_plugin_handle handle)
+{
+    for (ProcFile& f : procfiles)
+    {
+        f.fd = open(f.path, O_RDONLY | O_CLOEXEC);
+
+        if (f.fd < 0)
+        {
+            warn("Failed to open %s: %s", f.path, strerror(errno));
+        }
+    }
+
+    // Process uid entries.
+    GetDataFnType fns[] = { getCPUData, getCoresData, getRAMData, getNetData, getDiskData, getLoadData };
+
+    for (size_t i = 0; i < std::size(sources); i++)
+    {
+        if (sources[i].uid != 0)
+        {
+            calltable[sources[i].uid] = fns[i];
+        }
+    }
+
+    // Prime the counters so the first rates cover a real interval
+    snapshot(~0u);
+
+    cpu.update(cpusnap.all, procfiles[PROC_STAT].msec);
+    cores.update(cpusnap, procfiles[PROC_STAT].msec);
+    net.update(netsnap, procfiles[PROC_NETDEV].msec);
+    disk.update(disksnap, procfiles[PROC_DISKSTATS].msec);
+
+    return true;
+}
+
+bool sys_perf_shutdown(quasar_plugin_handle handle)
+{
+    for (ProcFile& f : procfiles)
+    {
+        if (f.fd >= 0)
+        {
+            close(f.fd);
+            f.fd = -1;
+        }
+    }
+
+    return true;
+}
+
+bool sys_perf_get_data(size_t srcUid, quasar_data_handle hData)
+{
+    auto it = calltable.find(srcUid);
+
+    if (it == calltable.end())
+    {
+        warn("Unknown source %zu", srcUid);
+        return false;
+    }
+
+    snapshot(files_for(srcUid));
+
+    return it->second(hData);
+}
+
+bool sys_perf_get_data_batch(const size_t* srcUids, quasar_data_handle* hData, bool* ok, size_t count)
+{
+    unsigned files = 0;
+    bool     ret   = true;
+
+    // One snapshot for everything due this tick
+    for (size_t i = 0; i < count; i++)
+    {
+        files |= files_for(srcUids[i]);
+    }
+
+    snapshot(files);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto it = calltable.find(srcUids[i]);
+
+        if (it == calltable.end())
+        {
+            warn("Unknown source %zu", srcUids[i]);
+            ok[i] = false;
+            ret   = false;
+            continue;
+        }
+
+        ok[i] = it->second(hData[i]);
+        ret   = ok[i] && ret;
+    }
+
+    return ret;
+}
+
+quasar_plugin_info_t info =
+    {
+        QUASAR_API_VERSION,
+        PLUGIN_NAME,
+        PLUGIN_CODE,
+        "v1",
+        "me",
+        "Queries CPU, memory, network, disk and load numbers from procfs",
+
+        std::size(sources),
+        sources,
+
+        sys_perf_init,
+        sys_perf_shutdown,
+        sys_perf_get_data,
+        nullptr,
+        nullptr,
+        sys_perf_get_data_batch
+    };
+
+quasar_plugin_info_t* quasar_plugin_load(void)
+{
+    return &info;
+}
+
+void quasar_plugin_destroy(quasar_plugin_info_t* info)
+{
+    // does nothing; info is static
+}
@@ -0,0 +1,472 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <plugin_api.h>
+#include <plugin_support.h>
+
+#define PLUGIN_NAME "Linux Top Processes"
+#define PLUGIN_CODE "linux_top_procs"
+
+#define qlog(l, f, ...)                                                \
+    {                                                                  \
+        char msg[256];                                                 \
+        snprintf(msg, sizeof(msg), PLUGIN_CODE ": " f, ##__VA_ARGS__); \
+        quasar_log(l, msg);                                            \
+    }
+
+#define info(f, ...) qlog(QUASAR_LOG_INFO, f, ##__VA_ARGS__)
+#define warn(f, ...) qlog(QUASAR_LOG_WARNING, f, ##__VA_ARGS__)
+
+// Processes are scanned on a background task this often, sources send the latest
+// result. Matches the default refresh of the sources
+#define SCAN_INTERVAL_MS 1000
+
+// Share of the open file limit used to keep /proc/<pid>/stat open across ticks,
+// processes past it are opened and closed on every scan
+#define FD_BUDGET_DIVISOR 4
+
+enum TopDataSources
+{
+    TOP_SRC_CPU = 0,
+    TOP_SRC_MEM
+};
+
+quasar_data_source_t sources[2] =
+    {
+        { "cpu", 1000, 0 },
+        { "mem", 1000, 0 }
+    };
+
+// What is remembered about a process between scans
+struct ProcState
+{
+    int      pid       = 0;
+    int      fd        = -1;
+    uint64_t starttime = 0; // tells a reused pid apart
+    uint64_t ticks     = 0; // utime + stime at the last scan
+    uint64_t seen      = 0; // scan generation
+    double   cpu       = 0; // percent of one core
+    uint64_t rss       = 0; // bytes
+    char     name[16]  = {};
+};
+
+// Owned by the scan, which runs on one task at a time
+static std::unordered_map<int, ProcState> procs;
+static std::vector<const ProcState*>      bycpu;
+static std::vector<const ProcState*>      bymem;
+
+// Result of the latest scan, copied out for the sources
+static std::mutex             toplock;
+static std::vector<ProcState> topcpu;
+static std::vector<ProcState> topmem;
+
+static quasar_task_handle  scanTask;
+static DIR*                procdir;
+static uint64_t            generation;
+static uint64_t            lastscan; // msec
+static std::atomic<size_t> topcount{ 10 };
+static size_t              fdbudget;
+static size_t              openfds;
+static long                clktck;
+static long                pagesize;
+
+static uint64_t now_msec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t parse_u64(const char*& p)
+{
+    uint64_t v = 0;
+
+    while (*p == ' ')
+        p++;
+
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+
+    return v;
+}
+
+static void skip_fields(const char*& p, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        while (*p == ' ')
+            p++;
+
+        while (*p && *p != ' ')
+            p++;
+    }
+}
+
+// Reads /proc/<pid>/stat, returns false once the process is gone
+static bool read_stat(int pid, ProcState& st, bool fresh, double elapsedTicks)
+{
+    char buf[512];
+    int  fd = st.fd;
+
+    if (fd < 0)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "%d/stat", pid);
+
+        fd = openat(dirfd(procdir), path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        // Keep it for the next scans while the budget allows
+        if (openfds < fdbudget)
+        {
+            st.fd = fd;
+            openfds++;
+        }
+    }
+
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (st.fd != fd)
+    {
+        close(fd);
+    }
+
+    if (n <= 0)
+    {
+        return false;
+    }
+
+    buf[n] = 0;
+
+    // pid (comm) state ppid ..., comm may itself hold spaces and parentheses
+    const char* open  = strchr(buf, '(');
+    const char* close = strrchr(buf, ')');
+
+    if (!open || !close || close < open)
+    {
+        return false;
+    }
+
+    // fields after comm, counted from state = 3
+    const char* p = close + 1;
+
+    skip_fields(p, 11);
+    uint64_t utime = parse_u64(p);
+    uint64_t stime = parse_u64(p);
+    skip_fields(p, 6);
+    uint64_t starttime = parse_u64(p);
+    skip_fields(p, 1);
+    uint64_t rss = parse_u64(p);
+
+    if (fresh || starttime != st.starttime)
+    {
+        size_t len = std::min<size_t>(close - open - 1, sizeof(st.name) - 1);
+        memcpy(st.name, open + 1, len);
+        st.name[len] = 0;
+
+        st.starttime = starttime;
+        st.cpu       = 0;
+    }
+    else if (elapsedTicks > 0 && utime + stime >= st.ticks)
+    {
+        st.cpu = std::round(1000.0 * (utime + stime - st.ticks) / elapsedTicks) / 10.0;
+    }
+
+    st.ticks = utime + stime;
+    st.rss   = rss * pagesize;
+
+    return true;
+}
+
+// Keeps the count largest entries by key in a min-heap, then sorts them descending
+template <typename Key>
+static void select_top(std::vector<const ProcState*>& out, Key key)
+{
+    auto cmp = [&key](const ProcState* a, const ProcState* b) { return key(a) > key(b); };
+
+    std::priority_queue<const ProcState*, std::vector<const ProcState*>, decltype(cmp)> heap(cmp);
+
+    size_t count = topcount;
+
+    for (auto& it : procs)
+    {
+        const ProcState* st = &it.second;
+
+        if (heap.size() < count)
+        {
+            heap.push(st);
+        }
+        else if (key(st) > key(heap.top()))
+        {
+            heap.pop();
+            heap.push(st);
+        }
+    }
+
+    out.clear();
+
+    while (!heap.empty())
+    {
+        out.push_back(heap.top());
+        heap.pop();
+    }
+
+    std::reverse(out.begin(), out.end());
+}
+
+static void publish(std::vector<ProcState>& out, const std::vector<const ProcState*>& top)
+{
+    out.clear();
+
+    for (const ProcState* st : top)
+    {
+        out.push_back(*st);
+    }
+}
+
+// Reads every process, about 5 us each in /proc/<pid>/stat alone, so it stays
+// off the thread sending data
+static void scan()
+{
+    uint64_t now          = now_msec();
+    double   elapsedTicks = lastscan ? (now - lastscan) * clktck / 1000.0 : 0;
+
+    lastscan = now;
+    generation++;
+
+    rewinddir(procdir);
+
+    while (dirent* ent = readdir(procdir))
+    {
+        if (ent->d_name[0] < '1' || ent->d_name[0] > '9')
+        {
+            continue;
+        }
+
+        int        pid   = atoi(ent->d_name);
+        auto       res   = procs.try_emplace(pid);
+        ProcState& st    = res.first->second;
+        bool       fresh = res.second;
+
+        st.pid = pid;
+
+        if (read_stat(pid, st, fresh, elapsedTicks))
+        {
+            st.seen = generation;
+        }
+    }
+
+    // Forget processes that exited
+    for (auto it = procs.begin(); it != procs.end();)
+    {
+        if (it->second.seen != generation)
+        {
+            if (it->second.fd >= 0)
+            {
+                close(it->second.fd);
+                openfds--;
+            }
+
+            it = procs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    select_top(bycpu, [](const ProcState* st) { return st->cpu; });
+    select_top(bymem, [](const ProcState* st) { return st->rss; });
+
+    std::lock_guard<std::mutex> lk(toplock);
+
+    publish(topcpu, bycpu);
+    publish(topmem, bymem);
+}
+
+static void ScanTask(quasar_task_handle task, void* userdata)
+{
+    scan();
+}
+
+// [[pid, name, cpu, rss], ...]
+static bool send_top(quasar_data_handle hData, const std::vector<ProcState>& top)
+{
+    std::lock_guard<std::mutex> lk(toplock);
+
+    quasar_data_begin_array(hData, nullptr);
+
+    for (const ProcState& st : top)
+    {
+        quasar_data_begin_array(hData, nullptr);
+        quasar_data_add_int(hData, nullptr, st.pid);
+        quasar_data_add_string(hData, nullptr, st.name);
+        quasar_data_add_double(hData, nullptr, st.cpu);
+        quasar_data_add_int(hData, nullptr, st.rss);
+        quasar_data_end_array(hData);
+    }
+
+    quasar_data_end_array(hData);
+
+    return true;
+}
+
+bool top_procs_shutdown(quasar_plugin_handle handle);
+
+bool top_procs_init(quasar_plugin_handle handle)
+{
+    procdir = opendir("/proc");
+
+    if (!procdir)
+    {
+        warn("Failed to open /proc: %s", strerror(errno));
+        return false;
+    }
+
+    clktck   = sysconf(_SC_CLK_TCK);
+    pagesize = sysconf(_SC_PAGESIZE);
+
+    rlimit lim;
+    fdbudget = (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY) ? lim.rlim_cur / FD_BUDGET_DIVISOR : 256;
+
+    // Baseline for the first cpu deltas
+    scan();
+
+    scanTask = quasar_task_run_periodic(handle, ScanTask, nullptr, SCAN_INTERVAL_MS, QUASAR_TASK_NONE);
+
+    if (nullptr == scanTask)
+    {
+        warn("Failed to start process scan task");
+        top_procs_shutdown(handle);
+        return false;
+    }
+
+    return true;
+}
+
+bool top_procs_shutdown(quasar_plugin_handle handle)
+{
+    // Already cancelled, a scan may still be running
+    if (scanTask)
+    {
+        quasar_task_wait(scanTask);
+        quasar_task_release(scanTask);
+        scanTask = nullptr;
+    }
+
+    for (auto& it : procs)
+    {
+        if (it.second.fd >= 0)
+        {
+            close(it.second.fd);
+        }
+    }
+
+    procs.clear();
+    bycpu.clear();
+    bymem.clear();
+    topcpu.clear();
+    topmem.clear();
+    openfds  = 0;
+    lastscan = 0;
+
+    if (procdir)
+    {
+        closedir(procdir);
+        procdir = nullptr;
+    }
+
+    return true;
+}
+
+bool top_procs_get_data(size_t srcUid, quasar_data_handle hData)
+{
+    if (srcUid == sources[TOP_SRC_CPU].uid)
+    {
+        return send_top(hData, topcpu);
+    }
+    else if (srcUid == sources[TOP_SRC_MEM].uid)
+    {
+        return send_top(hData, topmem);
+    }
+
+    warn("Unknown source %zu", srcUid);
+    return false;
+}
+
+bool top_procs_get_data_batch(const size_t* srcUids, quasar_data_handle* hData, bool* ok, size_t count)
+{
+    bool ret = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ok[i] = top_procs_get_data(srcUids[i], hData[i]);
+        ret   = ok[i] && ret;
+    }
+
+    return ret;
+}
+
+quasar_settings_t* top_procs_create_settings()
+{
+    quasar_settings_t* settings = quasar_create_settings();
+
+    quasar_add_int(settings, "count", "Number of processes", 1, 100, 1, 10);
+
+    return settings;
+}
+
+void top_procs_update_settings(quasar_settings_t* settings)
+{
+    topcount = quasar_get_uint(settings, "count");
+}
+
+quasar_plugin_info_t info =
+    {
+        QUASAR_API_VERSION,
+        PLUGIN_NAME,
+        PLUGIN_CODE,
+        "v1",
+        "me",
+        "Lists the processes using the most CPU and memory",
+
+        std::size(sources),
+        sources,
+
+        top_procs_init,
+        top_procs_shutdown,
+        top_procs_get_data,
+        top_procs_create_settings,
+        top_procs_update_settings,
+        top_procs_get_data_batch
+    };
+
+quasar_plugin_info_t* quasar_plugin_load(void)
+{
+    return &info;
+}
+
+void quasar_plugin_destroy(quasar_plugin_info_t* info)
+{
+    // does nothing; info is static
+}
@@ -1,7 +1,7 @@
 // Adapted from the Rainmeter AudioLevel plugin
 
-#include <array>
-#include <limits>
+#include <algorithm>
+#include <cmath>
 #include <mutex>
 #include <shared_mutex>
 #include <vector>
@@ -15,11 +15,8 @@
 #include <plugin_api.h>
 #include <plugin_support.h>
 
-#include <kfr/dft.hpp>
-#include <kfr/dsp.hpp>
-#include <kfr/math.hpp>
-
-#define CLAMP01(x) kfr::max(0.0, kfr::min(1.0, (x)))
+#include <spectrumengine.h>
+#include <spectrumoutput.h>
 
 #define PLUGIN_NAME "Audio Visualization Data"
 #define PLUGIN_CODE "win_audio_viz"
@@ -27,8 +24,6 @@
 // Process once every 10 buffers (~50-100ms)
 #define VIZ_BUFFER_LIMIT 10
 
-#define VIZ_MAX_CHANNELS 8
-
 #define qlog(l, f, ...)                                                \
     {                                                                  \
         char msg[256];                                                 \
@@ -42,13 +37,24 @@
 
 #include "cleanup.h"
 
-quasar_data_source_t sources[1] =
-    {
-        { "viz", -1, 0 }
+enum VizDataSources
+{
+    VIZ_SRC_SPECTRUM = 0,
+    VIZ_SRC_CHANNELS,
+    VIZ_SRC_LEVELS,
+    VIZ_SRC_WAVEFORM,
+    VIZ_SRC_BEAT
+};
+
+quasar_data_source_t sources[5] =
+    {
+        { "viz", -1, 0 },
+        { "viz_channels", -1, 0 },
+        { "levels", -1, 0 },
+        { "waveform", -1, 0 },
+        { "beat", -1, 0 }
     };
 
-using namespace kfr;
-
 namespace
 {
     enum WaveFormat
@@ -60,28 +66,19 @@ namespace
 
     quasar_plugin_handle plugHandle = nullptr;
 
-    IMMDevice* pMMDevice     = nullptr;
-    HANDLE     hThread       = nullptr;
-    HANDLE     hStartedEvent = nullptr;
-    HANDLE     hStopEvent    = nullptr;
-    HRESULT    threadResult  = S_OK;
+    IMMDevice*         pMMDevice     = nullptr;
+    quasar_task_handle hCaptureTask  = nullptr;
+    HANDLE             hStartedEvent = nullptr;
+    HANDLE             hStopEvent    = nullptr;
+    HRESULT            threadResult  = S_OK;
 
-    size_t m_fftsize     = 256;
-    double m_sensitivity = 50.0;
-    double m_freqmin     = 20.0;
-    double m_freqmax     = 20000.0;
-    size_t m_numbands    = 32;
-    size_t m_nchannels   = VIZ_MAX_CHANNELS;
+    size_t m_wavepoints = SPECTRUM_DEFAULT_WAVEFORM;
 
-    std::vector<double>                               spectrumFreqs;
-    std::array<std::vector<double>, VIZ_MAX_CHANNELS> spectrum;
-    std::shared_mutex                                 spectrumMutex;
+    // Guarded by output.mutex()
+    SpectrumEngine engine;
+    SpectrumOutput output(engine);
 
     WaveFormat s_format = FORMAT_INV;
-
-    std::array<univector<complex<double>>, VIZ_MAX_CHANNELS> fftIn;
-    std::array<univector<complex<double>>, VIZ_MAX_CHANNELS> fftOut;
-    std::array<univector<double>, VIZ_MAX_CHANNELS>          fftMag;
 }
 
 HRESULT LoopbackCapture(
@@ -155,7 +152,6 @@ HRESULT LoopbackCapture(
 
     // Process once every 10 buffers
     size_t samplePass = 0;
-    m_nchannels       = pwfx->nChannels;
 
     // create a periodic waitable timer
     HANDLE hWakeUp = CreateWaitableTimer(NULL, FALSE, NULL);
@@ -241,15 +237,11 @@ HRESULT LoopbackCapture(
 
     debug("Audio capture thread running");
 
-    // reserve memory
-    for (size_t chan = 0; chan < pwfx->nChannels; chan++)
     {
-        // fill default
-        spectrum[chan].resize(m_numbands, 0.0);
-        fftMag[chan].resize(m_fftsize, 0.0);
+        std::unique_lock<std::shared_mutex> lock(output.mutex());
 
-        // reserve only
-        fftIn[chan].reserve(m_fftsize);
+        engine.setFormat(pwfx->nChannels, pwfx->nSamplesPerSec);
+        output.reset();
     }
 
     // loopback capture loop
@@ -278,104 +270,26 @@ HRESULT LoopbackCapture(
         }
 
         {
-            std::unique_lock<std::shared_mutex> lock(spectrumMutex);
+            std::unique_lock<std::shared_mutex> lock(output.mutex());
 
+            bool ready;
+
+            if (dwFlags & AUDCLNT_BUFFERFLAGS_SILENT)
             {
-                float*       sF32   = (float*) pData;
-                INT16*       sI16   = (INT16*) pData;
-                const double scalar = (double) (1.0 / kfr::sqrt(m_fftsize));
-
-                for (size_t frame = 0; frame < nNumFramesToRead; frame++)
-                {
-                    for (size_t chan = 0; chan < pwfx->nChannels; chan++)
-                    {
-                        fftIn[chan].push_back(make_complex(s_format == FORMAT_FL32 ? (double) *sF32++ : (double) *sI16++ * 1.0 / 0x7fff, 0.0));
-                    }
-
-                    if (fftIn[0].size() >= m_fftsize)
-                    {
-                        auto window = to_pointer(window_hann<double>(m_fftsize));
-
-                        for (size_t chan = 0; chan < pwfx->nChannels; chan++)
-                        {
-                            if (!(dwFlags & AUDCLNT_BUFFERFLAGS_SILENT))
-                            {
-                                fftIn[chan] = fftIn[chan] * window;
-
-                                fftOut[chan] = dft(fftIn[chan]);
-                            }
-                            else
-                            {
-                                fftOut[chan].resize(m_fftsize, 0.0);
-                            }
-
-                            for (size_t b = 0; b < m_fftsize; b++)
-                            {
-                                fftMag[chan][b] = (kfr::sqr(fftOut[chan][b].real()) + kfr::sqr(fftOut[chan][b].imag())) * scalar;
-                            }
-
-                            fftIn[chan].clear();
-                        }
-                    }
-                }
+                ready = engine.pushSilence(nNumFramesToRead);
+            }
+            else if (s_format == FORMAT_FL32)
+            {
+                ready = engine.pushFloat((const float*) pData, nNumFramesToRead);
+            }
+            else
+            {
+                ready = engine.pushInt16((const int16_t*) pData, nNumFramesToRead);
             }
 
+            if (ready)
             {
-                const double df     = (double) pwfx->nSamplesPerSec / m_fftsize;
-                const double scalar = 2.0f / (double) pwfx->nSamplesPerSec;
-
-                for (size_t chan = 0; chan < pwfx->nChannels; chan++)
-                {
-                    std::fill(spectrum[chan].begin(), spectrum[chan].end(), 0.0);
-
-                    size_t bin  = 0;
-                    size_t band = 0;
-                    double f0   = 0.0;
-
-                    while (bin <= (m_fftsize / 2) && band < m_numbands)
-                    {
-                        double  fLin1 = ((double) bin + 0.5) * df;
-                        double  fLog1 = spectrumFreqs[band];
-                        double  x     = fftMag[chan][bin];
-                        double& y     = (spectrum[chan])[band];
-
-                        if (fLin1 <= fLog1)
-                        {
-                            y += (fLin1 - f0) * x * scalar;
-                            f0 = fLin1;
-                            bin += 1;
-                        }
-                        else
-                        {
-                            y += (fLog1 - f0) * x * scalar;
-                            f0 = fLog1;
-                            band += 1;
-                        }
-                    }
-                }
-
-                // scale
-                double maxMag = 0.0;
-                for (size_t b = 0; b < m_numbands; b++)
-                {
-                    double x = spectrum[0][b];
-
-                    if (pwfx->nChannels >= 2)
-                    {
-                        // combine channels
-                        x = (spectrum[0][b] + spectrum[1][b]) * 0.5;
-                    }
-
-                    x              = CLAMP01(x);
-                    spectrum[0][b] = kfr::max(0.0, 10.0 / m_sensitivity * kfr::log10(x) + 1.0);
-
-                    if (spectrum[0][b] > maxMag)
-                    {
-                        maxMag = spectrum[0][b];
-                    }
-                }
-
-                silentPacket = (maxMag == 0.0);
+                silentPacket = !output.update();
             }
         }
 
@@ -390,7 +304,7 @@ HRESULT LoopbackCapture(
                 sentOneZero = silentPacket;
 
                 // only send if not silent
-                quasar_signal_data_ready(plugHandle, "viz");
+                output.sendAll(plugHandle, sources, std::size(sources));
             }
 
             samplePass = 0;
@@ -429,36 +343,22 @@ HRESULT LoopbackCapture(
     return hr;
 }
 
-DWORD WINAPI LoopbackCaptureThreadFunction(LPVOID pContext)
+void LoopbackCaptureTask(quasar_task_handle task, void* userdata)
 {
+    // Wakes up init() if capture never got going
+    SetEventOnExit setStartedEvent(hStartedEvent);
+
     threadResult = CoInitialize(NULL);
     if (FAILED(threadResult))
     {
         warn("CoInitialize failed: hr = 0x%08lx", threadResult);
-        return 0;
+        return;
     }
     CoUninitializeOnExit cuoe;
 
     threadResult = LoopbackCapture(pMMDevice, hStartedEvent, hStopEvent);
 
-    info("Audio capture thread stopped");
-
-    return 0;
-}
-
-void calculate_freq_bands()
-{
-    // reserver memory
-    spectrumFreqs.resize(m_numbands, 0.0);
-
-    // calculate band frequencies
-    const double step = (kfr::log(m_freqmax / m_freqmin) / m_numbands) / kfr::log(2.0);
-    spectrumFreqs[0]  = (double) (m_freqmin * kfr::pow(2.0, step / 2.0));
-
-    for (size_t i = 1; i < m_numbands; ++i)
-    {
-        spectrumFreqs[i] = (double) (spectrumFreqs[i - 1] * kfr::pow(2.0, step));
-    }
+    info("Audio capture task stopped");
 }
 
 void win_audio_viz_cleanup()
@@ -478,18 +378,13 @@ void win_audio_viz_cleanup()
         CloseHandleOnExit closeStop(hStopEvent);
     }
 
-    if (nullptr != hThread)
-    {
-        CloseHandleOnExit closeThread(hThread);
-    }
+    hCaptureTask = nullptr;
 }
 
 bool win_audio_viz_init(quasar_plugin_handle handle)
 {
     plugHandle = handle;
 
-    calculate_freq_bands();
-
     // Get default device
     HRESULT              hr = S_OK;
     IMMDeviceEnumerator* pMMDeviceEnumerator;
@@ -532,31 +427,30 @@ bool win_audio_viz_init(quasar_plugin_handle handle)
         return false;
     }
 
-    hThread = CreateThread(
-        NULL, 0, LoopbackCaptureThreadFunction, NULL, 0, NULL);
-    if (NULL == hThread)
+    hCaptureTask = quasar_task_run_loop(handle, LoopbackCaptureTask, nullptr, QUASAR_TASK_REALTIME);
+    if (nullptr == hCaptureTask)
     {
-        warn("CreateThread failed: last error is %lu", GetLastError());
+        warn("Failed to start audio capture task");
         win_audio_viz_cleanup();
         return false;
     }
 
-    // wait for either capture to start or the thread to end
-    HANDLE waitArray[2] = { hStartedEvent, hThread };
-    DWORD  dwWaitResult;
-    dwWaitResult = WaitForMultipleObjects(
-        ARRAYSIZE(waitArray), waitArray, FALSE, INFINITE);
+    // wait for either capture to start or the task to end
+    DWORD dwWaitResult = WaitForSingleObject(hStartedEvent, INFINITE);
 
-    if (WAIT_OBJECT_0 + 1 == dwWaitResult)
+    if (WAIT_OBJECT_0 != dwWaitResult)
     {
-        warn("Thread aborted before starting to loopback capture: hr = 0x%08lx", threadResult);
+        warn("Unexpected WaitForSingleObject return value %lu", dwWaitResult);
+        SetEvent(hStopEvent);
+        quasar_task_wait(hCaptureTask);
         win_audio_viz_cleanup();
         return false;
     }
 
-    if (WAIT_OBJECT_0 != dwWaitResult)
+    if (FAILED(threadResult))
     {
-        warn("Unexpected WaitForMultipleObjects return value %lu", dwWaitResult);
+        warn("Task aborted before starting to loopback capture: hr = 0x%08lx", threadResult);
+        quasar_task_wait(hCaptureTask);
         win_audio_viz_cleanup();
         return false;
     }
@@ -566,27 +460,14 @@ bool win_audio_viz_init(quasar_plugin_handle handle)
 
 bool win_audio_viz_shutdown(quasar_plugin_handle handle)
 {
-    {
-        WaitForSingleObjectOnExit waitForThread(hThread);
-        SetEventOnExit            setStopEvent(hStopEvent);
-    }
-
-    DWORD exitCode;
-    if (!GetExitCodeThread(hThread, &exitCode))
-    {
-        warn("GetExitCodeThread failed: last error is %lu", GetLastError());
-        return false;
-    }
-
-    if (0 != exitCode)
-    {
-        warn("Loopback capture thread exit code is %lu; expected 0", exitCode);
-        return false;
-    }
+    // The capture loop waits on the stop event rather than polling for cancellation
+    SetEvent(hStopEvent);
+    quasar_task_wait(hCaptureTask);
 
     if (S_OK != threadResult)
     {
-        warn("Thread HRESULT is 0x%08lx", threadResult);
+        warn("Task HRESULT is 0x%08lx", threadResult);
+        win_audio_viz_cleanup();
         return false;
     }
 
@@ -597,13 +478,27 @@ bool win_audio_viz_shutdown(quasar_plugin_handle handle)
 
 bool win_audio_viz_get_data(size_t srcUid, quasar_data_handle hData)
 {
-    if (srcUid == sources->uid)
-    {
-        std::shared_lock<std::shared_mutex> lock(spectrumMutex);
+    std::shared_lock<std::shared_mutex> lock(output.mutex());
 
-        quasar_set_data_double_array(hData, spectrum[0].data(), spectrum[0].size());
-
-        return true;
+    if (srcUid == sources[VIZ_SRC_SPECTRUM].uid)
+    {
+        return output.sendSpectrum(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_CHANNELS].uid)
+    {
+        return output.sendChannels(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_LEVELS].uid)
+    {
+        return output.sendLevels(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_WAVEFORM].uid)
+    {
+        return output.sendWaveform(hData);
+    }
+    else if (srcUid == sources[VIZ_SRC_BEAT].uid)
+    {
+        return output.sendBeat(hData);
     }
 
     warn("Unknown source %Iu", srcUid);
@@ -620,51 +515,39 @@ quasar_settings_t* win_audio_viz_create_settings()
     quasar_add_double(settings, "freqmin", "Band Frequency Min (Hz)", 0.0, 20000.0, 0.1, 20.0);
     quasar_add_double(settings, "freqmax", "Band Frequency Band Max (Hz)", 0.0, 20000.0, 0.1, 20000.0);
     quasar_add_int(settings, "numbands", "Number of Bands", 0, 1024, 1, 32);
+    quasar_add_int(settings, "wavepoints", "Waveform Points", 1, 8192, 1, SPECTRUM_DEFAULT_WAVEFORM);
 
     return settings;
 }
 
 void win_audio_viz_update_settings(quasar_settings_t* settings)
 {
-    bool recalc = false;
-
     size_t fftsize     = quasar_get_uint(settings, "fftsize");
     double sensitivity = quasar_get_double(settings, "sensitivity");
     double freqmin     = quasar_get_double(settings, "freqmin");
     double freqmax     = quasar_get_double(settings, "freqmax");
     size_t numbands    = quasar_get_uint(settings, "numbands");
+    size_t wavepoints  = quasar_get_uint(settings, "wavepoints");
 
-    std::unique_lock<std::shared_mutex> lock(spectrumMutex);
-
-    m_sensitivity = sensitivity;
+    std::unique_lock<std::shared_mutex> lock(output.mutex());
 
-    if (fftsize != m_fftsize)
-    {
-        for (size_t chan = 0; chan < m_nchannels; chan++)
-        {
-            fftMag[chan].resize(m_fftsize, 0.0);
-            fftIn[chan].reserve(m_fftsize);
-        }
-    }
+    output.setSensitivity(sensitivity);
 
-    if (numbands != m_numbands)
+    if (wavepoints != m_wavepoints)
     {
-        recalc = true;
-
-        for (size_t chan = 0; chan < m_nchannels; chan++)
-        {
-            spectrum[chan].resize(m_numbands, 0.0);
-        }
+        m_wavepoints = wavepoints;
+        engine.setWaveformSize(wavepoints);
     }
 
-    if (freqmin != m_freqmin || freqmax != m_freqmax)
+    if (fftsize != engine.fftSize())
     {
-        recalc = true;
+        engine.setFftSize(fftsize);
     }
 
-    if (recalc)
+    if (numbands != engine.numBands() || freqmin != engine.freqMin() || freqmax != engine.freqMax())
     {
-        calculate_freq_bands();
+        engine.setBands(numbands, freqmin, freqmax);
+        output.reset();
     }
 }
 
@@ -675,7 +558,7 @@ quasar_plugin_info_t info =
         PLUGIN_CODE,
         "v1",
         "me",
-        "Supplies desktop audio frequency data",
+        "Supplies desktop audio spectrum, level, waveform and beat data",
 
         std::size(sources),
         sources,
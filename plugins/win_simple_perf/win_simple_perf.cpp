@@ -2,7 +2,7 @@
 
 #include <cstdio>
 #include <functional>
-#include <sstream>
+#include <string>
 #include <unordered_map>
 
 #include <plugin_api.h>
@@ -87,10 +87,10 @@ bool getRAMData(quasar_data_handle hData)
     DWORDLONG totalPhysMem = memInfo.ullTotalPhys;
     DWORDLONG physMemUsed  = memInfo.ullTotalPhys - memInfo.ullAvailPhys;
 
-    std::stringstream ss;
-    ss << "{ \"total\": " << totalPhysMem << ", \"used\": " << physMemUsed << " }";
-
-    quasar_set_data_json(hData, ss.str().c_str());
+    quasar_data_begin_object(hData, nullptr);
+    quasar_data_add_int(hData, "total", totalPhysMem);
+    quasar_data_add_int(hData, "used", physMemUsed);
+    quasar_data_end_object(hData);
 
     return true;
 }
@@ -131,6 +131,19 @@ bool simple_perf_get_data(size_t srcUid, quasar_data_handle hData)
     return false;
 }
 
+bool simple_perf_get_data_batch(const size_t* srcUids, quasar_data_handle* hData, bool* ok, size_t count)
+{
+    bool ret = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ok[i] = simple_perf_get_data(srcUids[i], hData[i]);
+        ret   = ok[i] && ret;
+    }
+
+    return ret;
+}
+
 quasar_plugin_info_t info =
     {
         QUASAR_API_VERSION,
@@ -147,7 +160,8 @@ quasar_plugin_info_t info =
         simple_perf_shutdown,
         simple_perf_get_data,
         nullptr,
-        nullptr
+        nullptr,
+        simple_perf_get_data_batch
     };
 
 quasar_plugin_info_t* quasar_plugin_load(void)
@@ -0,0 +1,487 @@
+#include "spectrumengine.h"
+
+#include <kfr/dsp.hpp>
+#include <kfr/math.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace kfr;
+
+namespace
+{
+    // Mean square and largest absolute sample in one pass, n a multiple of 8. Separate
+    // lanes let the compiler vectorize, single running values are serial dependency chains
+    void levels(const float* data, size_t n, float& power, float& peak)
+    {
+        float squares[8] = {};
+        float maxima[8]  = {};
+
+        for (size_t i = 0; i < n; i += 8)
+        {
+            for (size_t j = 0; j < 8; j++)
+            {
+                float x = data[i + j];
+                float a = std::abs(x);
+
+                squares[j] += x * x;
+                maxima[j] = maxima[j] < a ? a : maxima[j];
+            }
+        }
+
+        power = std::accumulate(squares, squares + 8, 0.f) / n;
+        peak  = *std::max_element(maxima, maxima + 8);
+    }
+}
+
+SpectrumEngine::SpectrumEngine()
+{
+    rebuild();
+}
+
+void SpectrumEngine::setFormat(size_t channels, double sampleRate)
+{
+    m_stride     = channels;
+    m_channels   = std::min<size_t>(channels, SPECTRUM_MAX_CHANNELS);
+    m_samplerate = sampleRate;
+
+    rebuild();
+}
+
+void SpectrumEngine::setFftSize(size_t fftsize)
+{
+    fftsize = std::clamp<size_t>(fftsize, SPECTRUM_MIN_FFTSIZE, SPECTRUM_MAX_FFTSIZE);
+
+    // Largest power of two not above the request
+    size_t pow2 = SPECTRUM_MIN_FFTSIZE;
+
+    while (pow2 * 2 <= fftsize)
+    {
+        pow2 *= 2;
+    }
+
+    m_fftsize = pow2;
+
+    rebuild();
+}
+
+void SpectrumEngine::setBands(size_t numbands, double freqmin, double freqmax)
+{
+    m_numbands = std::max<size_t>(numbands, 1);
+    m_freqmin  = freqmin;
+    m_freqmax  = freqmax;
+
+    rebuild();
+}
+
+void SpectrumEngine::setWaveformSize(size_t points)
+{
+    m_wavesize = std::max<size_t>(points, 1);
+
+    rebuild();
+}
+
+void SpectrumEngine::setWaveformEnabled(bool enabled)
+{
+    m_waveon = enabled;
+}
+
+void SpectrumEngine::setOnsetEnabled(bool enabled)
+{
+    if (enabled && !m_onseton)
+    {
+        resetOnset();
+    }
+
+    m_onseton = enabled;
+}
+
+void SpectrumEngine::rebuild()
+{
+    // Log-spaced band edges, each band an equal fraction of an octave
+    m_bandfreqs.assign(m_numbands, 0.0);
+
+    const double step = std::log2(m_freqmax / m_freqmin) / m_numbands;
+    m_bandfreqs[0]    = m_freqmin * std::pow(2.0, step / 2.0);
+
+    for (size_t i = 1; i < m_numbands; i++)
+    {
+        m_bandfreqs[i] = m_bandfreqs[i - 1] * std::pow(2.0, step);
+    }
+
+    // Plans are shared by every engine using the same size
+    if (!m_plan || m_plan->size != m_fftsize)
+    {
+        m_plan = dft_cache::instance().getreal(ctype<float>, m_fftsize);
+
+        // Assigning an expression fills a univector without resizing it
+        m_window.resize(m_fftsize);
+        m_window = window_hann<float>(m_fftsize);
+
+        m_frame.resize(m_fftsize);
+        m_mixframe.resize(m_fftsize);
+        m_fft.resize(numBins());
+        m_temp.resize(m_plan->temp_size);
+    }
+
+    buildBandWeights();
+
+    for (size_t chan = 0; chan < SPECTRUM_MAX_CHANNELS; chan++)
+    {
+        size_t n = chan < m_channels ? 1 : 0;
+
+        m_ring[chan].resize(n * m_fftsize);
+        m_mag[chan].resize(n * numBins());
+        m_bands[chan].resize(n * m_numbands);
+
+        std::fill(m_ring[chan].begin(), m_ring[chan].end(), 0.f);
+        std::fill(m_mag[chan].begin(), m_mag[chan].end(), 0.f);
+        std::fill(m_bands[chan].begin(), m_bands[chan].end(), 0.f);
+    }
+
+    m_mixbands.resize(m_numbands);
+    m_wave.resize(std::min(m_wavesize, m_fftsize));
+    m_wavebounds.resize(m_wave.size() + 1);
+
+    for (size_t i = 0; i < m_wavebounds.size(); i++)
+    {
+        m_wavebounds[i] = i * m_fftsize / m_wave.size();
+    }
+
+    m_onsetbands.resize(m_numbands);
+    m_onsetnext.resize(m_numbands);
+
+    std::fill(m_mixbands.begin(), m_mixbands.end(), 0.f);
+    std::fill(m_wave.begin(), m_wave.end(), 0.f);
+
+    // Flux history of about SPECTRUM_ONSET_HISTORY_MSEC worth of frames
+    size_t history = m_samplerate * SPECTRUM_ONSET_HISTORY_MSEC / 1000 / m_fftsize + 0.5;
+
+    m_fluxes.resize(std::max<size_t>(history, 4));
+
+    resetOnset();
+    resetLevels();
+
+    m_pos     = 0;
+    m_pending = 0;
+}
+
+void SpectrumEngine::resetLevels()
+{
+    std::fill(m_power.begin(), m_power.end(), 0.f);
+    std::fill(m_peak.begin(), m_peak.end(), 0.f);
+
+    m_levelframes = 0;
+    m_flux        = 0.f;
+    m_onset       = false;
+}
+
+void SpectrumEngine::resetOnset()
+{
+    std::fill(m_onsetbands.begin(), m_onsetbands.end(), 0.f);
+    std::fill(m_fluxes.begin(), m_fluxes.end(), 0.f);
+
+    m_fluxpos    = 0;
+    m_fluxframes = 0;
+    m_holdframes = 0;
+    m_above      = false;
+}
+
+template <typename Sample>
+bool SpectrumEngine::push(const Sample* data, size_t frames, float scale)
+{
+    bool ready = false;
+
+    while (frames)
+    {
+        // Up to the end of the ring or the next analysis, whichever comes first
+        size_t count = std::min({ frames, m_fftsize - m_pos, m_fftsize - m_pending });
+
+        for (size_t chan = 0; chan < m_channels; chan++)
+        {
+            float* ring = m_ring[chan].data() + m_pos;
+
+            if (data)
+            {
+                const Sample* in = data + chan;
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    ring[i] = in[i * m_stride] * scale;
+                }
+            }
+            else
+            {
+                std::fill(ring, ring + count, 0.f);
+            }
+        }
+
+        if (data)
+        {
+            data += count * m_stride;
+        }
+
+        frames -= count;
+        m_pos = (m_pos + count) & (m_fftsize - 1);
+        m_pending += count;
+
+        if (m_pending == m_fftsize)
+        {
+            // The first frame of this push
+            if (!ready)
+            {
+                resetLevels();
+            }
+
+            analyze();
+
+            m_pending = 0;
+            ready     = true;
+        }
+    }
+
+    return ready;
+}
+
+bool SpectrumEngine::pushFloat(const float* data, size_t frames)
+{
+    return push(data, frames, 1.f);
+}
+
+bool SpectrumEngine::pushInt16(const int16_t* data, size_t frames)
+{
+    return push(data, frames, 1.f / 0x7fff);
+}
+
+bool SpectrumEngine::pushSilence(size_t frames)
+{
+    return push<float>(nullptr, frames, 0.f);
+}
+
+void SpectrumEngine::analyze()
+{
+    const size_t tail   = m_fftsize - m_pos;
+    const float  scalar = 1.f / std::sqrt((float) m_fftsize);
+
+    std::fill(m_mixbands.begin(), m_mixbands.end(), 0.f);
+
+    if (m_waveon)
+    {
+        std::fill(m_mixframe.begin(), m_mixframe.end(), 0.f);
+    }
+
+    for (size_t chan = 0; chan < m_channels; chan++)
+    {
+        const float* ring   = m_ring[chan].data();
+        const float* window = m_window.data();
+        float*       frame  = m_frame.data();
+
+        // Levels do not depend on the order of the samples, so they come straight from the ring
+        float power, peak;
+        levels(ring, m_fftsize, power, peak);
+
+        m_power[chan] += power;
+        m_peak[chan] = std::max(m_peak[chan], peak);
+
+        // Unroll the ring oldest first, windowing on the way
+        for (size_t i = 0; i < tail; i++)
+        {
+            frame[i] = ring[m_pos + i] * window[i];
+        }
+
+        for (size_t i = 0; i < m_pos; i++)
+        {
+            frame[tail + i] = ring[i] * window[tail + i];
+        }
+
+        // The waveform needs the unwindowed samples in time order
+        if (m_waveon)
+        {
+            float* mix = m_mixframe.data();
+
+            for (size_t i = 0; i < tail; i++)
+            {
+                mix[i] += ring[m_pos + i];
+            }
+
+            for (size_t i = 0; i < m_pos; i++)
+            {
+                mix[tail + i] += ring[i];
+            }
+        }
+
+        m_plan->execute(m_fft.data(), m_frame.data(), m_temp.data());
+
+        m_mag[chan] = (sqr(real(m_fft)) + sqr(imag(m_fft))) * scalar;
+
+        reduceBands(chan);
+
+        m_mixbands = m_mixbands + m_bands[chan];
+    }
+
+    if (m_channels > 1)
+    {
+        m_mixbands = m_mixbands * (1.f / m_channels);
+    }
+
+    if (m_waveon)
+    {
+        reduceWaveform();
+    }
+
+    if (m_onseton)
+    {
+        detectOnset();
+    }
+
+    m_levelframes++;
+}
+
+// Decimates the channel mix, each waveform point the mean of a run of samples
+void SpectrumEngine::reduceWaveform()
+{
+    const float  scale = 1.f / std::max<size_t>(m_channels, 1);
+    const float* mix   = m_mixframe.data();
+
+    for (size_t i = 0; i < m_wave.size(); i++)
+    {
+        const uint32_t begin = m_wavebounds[i];
+        const uint32_t count = m_wavebounds[i + 1] - begin;
+
+        float y = 0.f;
+
+        for (uint32_t k = 0; k < count; k++)
+        {
+            y += mix[begin + k];
+        }
+
+        m_wave[i] = y * scale / count;
+    }
+}
+
+// Spectral flux onset detection on the mixed bands. Only bands getting louder count,
+// and a frame is an onset where the flux first rises above the adaptive threshold
+void SpectrumEngine::detectOnset()
+{
+    m_onsetnext = log10(m_mixbands * SPECTRUM_ONSET_GAIN + 1.f);
+
+    float flux = sum(max(m_onsetnext - m_onsetbands, 0.f)) / m_numbands;
+
+    std::swap(m_onsetbands, m_onsetnext);
+
+    // The first frame has nothing to compare against
+    if (m_fluxframes++ == 0)
+    {
+        return;
+    }
+
+    m_flux = std::max(m_flux, flux);
+
+    const size_t history = m_fluxes.size();
+
+    // Not until the history is full, the threshold is meaningless before
+    bool above = false;
+
+    if (m_fluxframes > history)
+    {
+        float mean     = sum(m_fluxes) / history;
+        float variance = std::max(sumsqr(m_fluxes) / history - mean * mean, 0.f);
+
+        float threshold = std::max({ mean + SPECTRUM_ONSET_THRESHOLD * std::sqrt(variance),
+                                     mean * SPECTRUM_ONSET_MIN_RATIO,
+                                     SPECTRUM_ONSET_MIN_FLUX });
+
+        above = flux > threshold;
+    }
+
+    if (m_holdframes)
+    {
+        m_holdframes--;
+    }
+
+    bool onset = above && !m_above && !m_holdframes;
+
+    m_onset |= onset;
+    m_above = above;
+
+    if (onset)
+    {
+        m_holdframes = m_samplerate * SPECTRUM_ONSET_HOLD_MSEC / 1000 / m_fftsize + 0.5;
+    }
+
+    m_fluxes[m_fluxpos] = flux;
+    m_fluxpos           = (m_fluxpos + 1) % history;
+}
+
+// Precomputes how much of each bin's power goes to each band. Bin k spans
+// [k - 1/2, k + 1/2] * df and band b spans [freq[b - 1], freq[b]], starting at 0 Hz,
+// so a bin contributes in proportion to its overlap with the band
+void SpectrumEngine::buildBandWeights()
+{
+    const double df     = m_samplerate / m_fftsize;
+    const double scalar = 2.0 / m_samplerate;
+    const size_t last   = numBins() - 1;
+    const double top    = (last + 0.5) * df;
+
+    std::vector<float> weights;
+
+    m_bandrows.assign(m_numbands, BandRow{ 0, 0, 0 });
+
+    double lo = 0.0;
+
+    for (size_t b = 0; b < m_numbands; b++)
+    {
+        double hi = std::min(m_bandfreqs[b], top);
+
+        if (hi > lo)
+        {
+            size_t kl = std::min<size_t>(lo / df + 0.5, last);
+            size_t kh = std::min<size_t>(hi / df + 0.5, last);
+
+            m_bandrows[b] = { (uint32_t) kl, (uint32_t) (kh - kl + 1), (uint32_t) weights.size() };
+
+            for (size_t k = kl; k <= kh; k++)
+            {
+                double overlap = std::min(hi, (k + 0.5) * df) - std::max(lo, (k - 0.5) * df);
+
+                weights.push_back(std::max(overlap, 0.0) * scalar);
+            }
+        }
+
+        lo = std::max(lo, hi);
+    }
+
+    m_bandweights.resize(weights.size());
+    std::copy(weights.begin(), weights.end(), m_bandweights.begin());
+}
+
+// Sparse matrix-vector product of the band weights and the bin power
+void SpectrumEngine::reduceBands(size_t chan)
+{
+    const float* mag     = m_mag[chan].data();
+    const float* weights = m_bandweights.data();
+    float*       bands   = m_bands[chan].data();
+
+    for (size_t b = 0; b < m_numbands; b++)
+    {
+        const BandRow& row = m_bandrows[b];
+
+        // Most low bands fall within one or two bins
+        if (row.count <= 2)
+        {
+            float y = 0.f;
+
+            for (uint32_t i = 0; i < row.count; i++)
+            {
+                y += mag[row.bin + i] * weights[row.offset + i];
+            }
+
+            bands[b] = y;
+        }
+        else
+        {
+            bands[b] = dotproduct(make_univector(mag + row.bin, row.count), make_univector(weights + row.offset, row.count));
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <kfr/dft.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Channels analysed at most, further interleaved channels are skipped
+#define SPECTRUM_MAX_CHANNELS 8
+
+// FFT sizes are rounded down to a power of two within these
+#define SPECTRUM_MIN_FFTSIZE 16
+#define SPECTRUM_MAX_FFTSIZE 65536
+
+// Waveform points per frame unless set otherwise
+#define SPECTRUM_DEFAULT_WAVEFORM 256
+
+// A frame is an onset when its spectral flux rises above the mean flux of about the
+// last second by this many standard deviations, to at least a multiple of the mean,
+// and above a floor so that noise in near-silence does not count. Onsets are at least
+// the hold time apart
+#define SPECTRUM_ONSET_HISTORY_MSEC 1000
+#define SPECTRUM_ONSET_THRESHOLD    2.0f
+#define SPECTRUM_ONSET_MIN_RATIO    3.0f
+#define SPECTRUM_ONSET_MIN_FLUX     0.01f
+#define SPECTRUM_ONSET_HOLD_MSEC    150
+
+// Band power is compressed to log10(1 + gain * power) before taking the flux, so a
+// change in loudness counts alike at any level
+#define SPECTRUM_ONSET_GAIN 1e5f
+
+// Band spectrum analysis of interleaved PCM, shared by the audio plugins.
+// Samples go into a preallocated ring buffer per channel. Once fftsize new frames
+// are in, the latest fftsize samples of every channel are windowed with a precomputed
+// Hann window, transformed with a cached real FFT plan, and reduced to power per
+// log-spaced band. The same pass also yields levels, a decimated waveform and an
+// onset flag, so every output comes from one FFT. The waveform and onset detection
+// are only computed while enabled. Nothing is allocated while pushing samples.
+// Not thread-safe, the caller serializes pushes, reads and reconfiguration
+class SpectrumEngine
+{
+public:
+    SpectrumEngine();
+
+    void setFormat(size_t channels, double sampleRate);
+    void setFftSize(size_t fftsize);
+    void setBands(size_t numbands, double freqmin, double freqmax);
+    void setWaveformSize(size_t points);
+
+    // Both on by default. Onset detection starts over when enabled again, so its
+    // threshold first needs about SPECTRUM_ONSET_HISTORY_MSEC of new frames
+    void setWaveformEnabled(bool enabled);
+    void setOnsetEnabled(bool enabled);
+
+    // Interleaved frames, returns true if at least one spectrum frame completed
+    bool pushFloat(const float* data, size_t frames);
+    bool pushInt16(const int16_t* data, size_t frames);
+    bool pushSilence(size_t frames);
+
+    size_t channels() const { return m_channels; }
+    size_t fftSize() const { return m_fftsize; }
+    size_t numBins() const { return m_fftsize / 2 + 1; }
+    size_t numBands() const { return m_numbands; }
+    double freqMin() const { return m_freqmin; }
+    double freqMax() const { return m_freqmax; }
+    double sampleRate() const { return m_samplerate; }
+    size_t waveformSize() const { return m_wave.size(); }
+
+    // Of the last completed frame, numBins() and numBands() values per channel
+    const float* magnitudes(size_t chan) const { return m_mag[chan].data(); }
+    const float* bands(size_t chan) const { return m_bands[chan].data(); }
+
+    // Band power averaged over all channels
+    const float* mixedBands() const { return m_mixbands.data(); }
+
+    // Levels, flux and onset cover every frame completed by the last push that
+    // completed one, so that a consumer reading once per push misses none
+    float rms(size_t chan) const { return std::sqrt(m_power[chan] / std::max<size_t>(m_levelframes, 1)); }
+    float peak(size_t chan) const { return m_peak[chan]; }
+
+    // Channel mix of the last completed frame in time order, each point the mean
+    // of fftSize() / waveformSize() samples
+    const float* waveform() const { return m_wave.data(); }
+
+    // Largest positive spectral flux of the mixed bands, and whether any frame was an onset
+    float flux() const { return m_flux; }
+    bool  onset() const { return m_onset; }
+
+    // Upper edge of each band in Hz
+    const std::vector<double>& bandFrequencies() const { return m_bandfreqs; }
+
+private:
+    // One row of the sparse bin-to-band weight matrix. The bins of a band are
+    // contiguous, so a row is a run of weights starting at a bin
+    struct BandRow
+    {
+        uint32_t bin;
+        uint32_t count;
+        uint32_t offset; // of the first weight in m_bandweights
+    };
+
+    template <typename Sample>
+    bool push(const Sample* data, size_t frames, float scale);
+
+    void rebuild();
+    void resetLevels();
+    void resetOnset();
+    void buildBandWeights();
+    void analyze();
+    void reduceBands(size_t chan);
+    void reduceWaveform();
+    void detectOnset();
+
+    size_t m_channels   = 0;
+    size_t m_stride     = 0; // interleaved channels in pushed data
+    double m_samplerate = 48000.0;
+    size_t m_fftsize    = 256;
+    size_t m_numbands   = 32;
+    double m_freqmin    = 20.0;
+    double m_freqmax    = 20000.0;
+    size_t m_wavesize   = SPECTRUM_DEFAULT_WAVEFORM;
+    bool   m_waveon     = true;
+    bool   m_onseton    = true;
+
+    std::vector<double>   m_bandfreqs;
+    std::vector<BandRow>  m_bandrows;
+    kfr::univector<float> m_bandweights;
+
+    kfr::dft_plan_real_ptr<float>       m_plan;
+    kfr::univector<float>               m_window;
+    kfr::univector<float>               m_frame; // samples in time order, windowed before the FFT
+    kfr::univector<kfr::complex<float>> m_fft;
+    kfr::univector<kfr::u8>             m_temp;
+
+    std::array<kfr::univector<float>, SPECTRUM_MAX_CHANNELS> m_ring;
+    std::array<kfr::univector<float>, SPECTRUM_MAX_CHANNELS> m_mag;
+    std::array<kfr::univector<float>, SPECTRUM_MAX_CHANNELS> m_bands;
+    std::array<float, SPECTRUM_MAX_CHANNELS>                 m_power       = {}; // mean square, summed over frames
+    std::array<float, SPECTRUM_MAX_CHANNELS>                 m_peak        = {};
+    size_t                                                   m_levelframes = 0; // in the levels
+
+    kfr::univector<float> m_mixbands;
+    kfr::univector<float> m_mixframe; // sum of the channels in time order
+    kfr::univector<float> m_wave;
+    std::vector<uint32_t> m_wavebounds; // first sample of each waveform point, and the end
+
+    kfr::univector<float> m_onsetbands; // compressed mixed bands of the previous frame
+    kfr::univector<float> m_onsetnext;  // and of this one
+    kfr::univector<float> m_fluxes;     // recent flux, a ring of about SPECTRUM_ONSET_HISTORY_MSEC
+    size_t                m_fluxpos    = 0;
+    size_t                m_fluxframes = 0; // analysed since the last rebuild
+    size_t                m_holdframes = 0; // left until another onset may follow
+    float                 m_flux       = 0.f;
+    bool                  m_onset      = false;
+    bool                  m_above      = false; // flux over the threshold in the previous frame
+
+    size_t m_pos     = 0; // next ring slot, the oldest sample once the ring is full
+    size_t m_pending = 0; // frames pushed since the last analysis
+};
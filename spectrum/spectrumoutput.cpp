@@ -0,0 +1,190 @@
+#include "spectrumoutput.h"
+
+#include <plugin_support.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+#define CLAMP01(x) std::max(0.0, std::min(1.0, (x)))
+
+namespace
+{
+    uint64_t now_msec()
+    {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool recent(const std::atomic<uint64_t>& request, uint64_t now)
+    {
+        uint64_t msec = request.load(std::memory_order_relaxed);
+        return msec && now - msec < SPECTRUM_OUTPUT_IDLE_MSEC;
+    }
+}
+
+SpectrumOutput::SpectrumOutput(SpectrumEngine& engine)
+    : m_engine(engine)
+{
+    reset();
+}
+
+double SpectrumOutput::scaleBand(double power) const
+{
+    return std::max(0.0, 10.0 / m_sensitivity * std::log10(CLAMP01(power)) + 1.0);
+}
+
+void SpectrumOutput::reset()
+{
+    m_spectrum.assign(m_engine.numBands(), 0.0);
+    m_pending = VizLevels();
+    m_sent    = VizLevels();
+}
+
+bool SpectrumOutput::update()
+{
+    const size_t numbands = m_engine.numBands();
+    const float* bands    = m_engine.mixedBands();
+
+    m_spectrum.resize(numbands);
+
+    // scale
+    double maxMag = 0.0;
+    for (size_t b = 0; b < numbands; b++)
+    {
+        m_spectrum[b] = scaleBand(bands[b]);
+
+        if (m_spectrum[b] > maxMag)
+        {
+            maxMag = m_spectrum[b];
+        }
+    }
+
+    for (size_t chan = 0; chan < m_engine.channels(); chan++)
+    {
+        m_pending.power[chan] += (double) m_engine.rms(chan) * m_engine.rms(chan);
+        m_pending.peak[chan] = std::max<double>(m_pending.peak[chan], m_engine.peak(chan));
+    }
+
+    m_pending.updates++;
+    m_pending.flux = std::max<double>(m_pending.flux, m_engine.flux());
+    m_pending.onset |= m_engine.onset();
+
+    // Only what is being fetched is computed for the next frames
+    uint64_t now = now_msec();
+
+    m_engine.setWaveformEnabled(recent(m_waverequest, now));
+    m_engine.setOnsetEnabled(recent(m_beatrequest, now));
+
+    return maxMag > 0.0;
+}
+
+void SpectrumOutput::sendAll(quasar_plugin_handle handle, const quasar_data_source_t* sources, size_t count)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+        // Without a new frame the levels stay, but their onset has been sent
+        if (m_pending.updates)
+        {
+            m_sent    = m_pending;
+            m_pending = VizLevels();
+        }
+        else
+        {
+            m_sent.onset = false;
+        }
+    }
+
+    // Sources without subscribers cost nothing more than the signal
+    for (size_t i = 0; i < count; i++)
+    {
+        quasar_signal_data_ready(handle, sources[i].dataSrc);
+    }
+}
+
+bool SpectrumOutput::sendSpectrum(quasar_data_handle hData)
+{
+    quasar_set_data_double_array(hData, m_spectrum.data(), m_spectrum.size());
+
+    return true;
+}
+
+bool SpectrumOutput::sendChannels(quasar_data_handle hData)
+{
+    quasar_data_begin_array(hData, nullptr);
+
+    for (size_t chan = 0; chan < m_engine.channels(); chan++)
+    {
+        const float* bands = m_engine.bands(chan);
+
+        quasar_data_begin_array(hData, nullptr);
+
+        for (size_t b = 0; b < m_engine.numBands(); b++)
+        {
+            quasar_data_add_double(hData, nullptr, scaleBand(bands[b]));
+        }
+
+        quasar_data_end_array(hData);
+    }
+
+    quasar_data_end_array(hData);
+
+    return true;
+}
+
+bool SpectrumOutput::sendLevels(quasar_data_handle hData)
+{
+    const size_t updates = std::max<size_t>(m_sent.updates, 1);
+
+    quasar_data_begin_object(hData, nullptr);
+
+    quasar_data_begin_array(hData, "rms");
+    for (size_t chan = 0; chan < m_engine.channels(); chan++)
+    {
+        quasar_data_add_double(hData, nullptr, std::sqrt(m_sent.power[chan] / updates));
+    }
+    quasar_data_end_array(hData);
+
+    quasar_data_begin_array(hData, "peak");
+    for (size_t chan = 0; chan < m_engine.channels(); chan++)
+    {
+        quasar_data_add_double(hData, nullptr, m_sent.peak[chan]);
+    }
+    quasar_data_end_array(hData);
+
+    quasar_data_end_object(hData);
+
+    return true;
+}
+
+bool SpectrumOutput::sendWaveform(quasar_data_handle hData)
+{
+    m_waverequest.store(now_msec(), std::memory_order_relaxed);
+
+    const float* wave = m_engine.waveform();
+
+    quasar_data_begin_array(hData, nullptr);
+
+    for (size_t i = 0; i < m_engine.waveformSize(); i++)
+    {
+        quasar_data_add_double(hData, nullptr, wave[i]);
+    }
+
+    quasar_data_end_array(hData);
+
+    return true;
+}
+
+bool SpectrumOutput::sendBeat(quasar_data_handle hData)
+{
+    m_beatrequest.store(now_msec(), std::memory_order_relaxed);
+
+    quasar_data_begin_object(hData, nullptr);
+    quasar_data_add_bool(hData, "onset", m_sent.onset);
+    quasar_data_add_double(hData, "flux", m_sent.flux);
+    quasar_data_end_object(hData);
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "spectrumengine.h"
+
+#include <plugin_api.h>
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+// The waveform and onsets are no longer computed once nobody has fetched them for this long
+#define SPECTRUM_OUTPUT_IDLE_MSEC 1000
+
+// Levels and onsets over the engine updates between two sends
+struct VizLevels
+{
+    size_t updates                      = 0;
+    double power[SPECTRUM_MAX_CHANNELS] = {}; // sum of the squared RMS of each update
+    double peak[SPECTRUM_MAX_CHANNELS]  = {};
+    double flux                         = 0.0;
+    bool   onset                        = false;
+};
+
+// The data sources of the audio plugins, built from a SpectrumEngine: the scaled
+// spectrum of the channel mix and of each channel, levels, waveform and beat.
+// update() takes in every completed engine frame and sendAll() hands what was
+// gathered to the sources. The engine computes the waveform and onsets only
+// while their sources are fetched.
+// mutex() guards the engine and everything here. sendAll() takes it itself,
+// everything else expects the caller to hold it, shared for the send functions
+class SpectrumOutput
+{
+public:
+    explicit SpectrumOutput(SpectrumEngine& engine);
+
+    std::shared_mutex& mutex() { return m_mutex; }
+
+    void setSensitivity(double sensitivity) { m_sensitivity = sensitivity; }
+
+    // Band power to the 0..1 shown by the visualizer
+    double scaleBand(double power) const;
+
+    // Clears the spectrum and levels, after the engine was reconfigured
+    void reset();
+
+    // Scales the spectrum of the frames completed by the last push and folds them
+    // into the levels of the next send. Returns false if the spectrum is all zero
+    bool update();
+
+    // Makes the levels gathered since the last send the ones sent, and signals the sources
+    void sendAll(quasar_plugin_handle handle, const quasar_data_source_t* sources, size_t count);
+
+    bool sendSpectrum(quasar_data_handle hData);
+    bool sendChannels(quasar_data_handle hData);
+    bool sendLevels(quasar_data_handle hData);
+    bool sendWaveform(quasar_data_handle hData);
+    bool sendBeat(quasar_data_handle hData);
+
+private:
+    SpectrumEngine&   m_engine;
+    std::shared_mutex m_mutex;
+
+    double              m_sensitivity = 50.0;
+    std::vector<double> m_spectrum;
+    VizLevels           m_pending;
+    VizLevels           m_sent;
+
+    // Last fetch in msec, written by the send functions under the shared lock
+    std::atomic<uint64_t> m_waverequest{ 0 };
+    std::atomic<uint64_t> m_beatrequest{ 0 };
+};
@@ -1,5 +1,6 @@
 #include "applauncher.h"
 
+#include "configstore.h"
 #include "dataserver.h"
 #include "widgetregistry.h"
 
@@ -7,7 +8,6 @@
 #include <QFileInfo>
 #include <QJsonObject>
 #include <QProcess>
-#include <QSettings>
 #include <QtWebSockets/QWebSocket>
 
 AppLauncher::AppLauncher(DataServer* s, WidgetRegistry* r, QObject* parent)
@@ -29,8 +29,7 @@ AppLauncher::AppLauncher(DataServer* s, WidgetRegistry* r, QObject* parent)
     using namespace std::placeholders;
     server->addHandler("launcher", std::bind(&AppLauncher::handleCommand, this, _1, _2));
 
-    QSettings settings;
-    m_map = settings.value("launcher/map").toMap();
+    m_map = ConfigStore::instance()->value("launcher/map").toMap();
 }
 
 const QVariantMap* AppLauncher::getMapForRead()
@@ -50,8 +49,7 @@ void AppLauncher::writeMap(QVariantMap& newmap)
     std::unique_lock<std::shared_mutex> lock(m_mutex);
     m_map = newmap;
 
-    QSettings settings;
-    settings.setValue("launcher/map", m_map);
+    ConfigStore::instance()->setValue("launcher/map", m_map);
 }
 
 void AppLauncher::handleCommand(const QJsonObject& req, QWebSocket* sender)
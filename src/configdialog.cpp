@@ -78,8 +78,8 @@ void ConfigDialog::changePage(QListWidgetItem* current, QListWidgetItem* previou
 
 void ConfigDialog::saveSettings()
 {
-    QSettings settings;
-    bool      restartNeeded = false;
+    ConfigStore& settings      = *ConfigStore::instance();
+    bool         restartNeeded = false;
 
     auto pages = pagesWidget->children();
 
@@ -4,6 +4,7 @@
 #include "dataplugin.h"
 #include "dataserver.h"
 #include "dataservices.h"
+#include "logwindow.h"
 #include "plugin_support_internal.h"
 #include "widgetdefs.h"
 
@@ -12,11 +13,12 @@
 namespace
 {
     // setting names
-    QString QUASAR_SETTING_PORT    = "portSpin";
-    QString QUASAR_SETTING_LOG     = "logCombo";
-    QString QUASAR_SETTING_COOKIE  = "cookieEdit";
-    QString QUASAR_SETTING_STARTUP = "startUp";
-    QString QUASAR_SETTING_LOGFILE = "logFile";
+    QString QUASAR_SETTING_PORT     = "portSpin";
+    QString QUASAR_SETTING_LOG      = "logCombo";
+    QString QUASAR_SETTING_COOKIE   = "cookieEdit";
+    QString QUASAR_SETTING_STARTUP  = "startUp";
+    QString QUASAR_SETTING_LOGFILE  = "logFile";
+    QString QUASAR_SETTING_RENDERER = "sharedRenderer";
 }
 
 GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
@@ -32,7 +34,7 @@ GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
 
     QLabel* portLabel = new QLabel(tr("Data Server port:"));
 
-    QSettings settings;
+    ConfigStore& settings = *ConfigStore::instance();
 
     // ------------------Port
     int port = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toInt();
@@ -93,6 +95,15 @@ GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
     logToFile->setObjectName(QUASAR_SETTING_LOGFILE);
     logToFile->setChecked(settings.value(QUASAR_CONFIG_LOGFILE, false).toBool());
 
+    // ------------------Shared renderer
+    QCheckBox* sharedRenderer = new QCheckBox("Share one renderer process between local widgets");
+    sharedRenderer->setObjectName(QUASAR_SETTING_RENDERER);
+    sharedRenderer->setChecked(settings.value(QUASAR_CONFIG_SHAREDRENDERER, false).toBool());
+
+    connect(sharedRenderer, &QCheckBox::toggled, [=] {
+        this->m_settingsModified = true;
+    });
+
 #ifdef WIN32
     // ------------------Startup launch
     QString   startupFolder = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/Startup";
@@ -115,8 +126,7 @@ GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
 
         if (msgBox.exec() == QMessageBox::Yes)
         {
-            QSettings settings;
-            settings.setValue(QUASAR_CONFIG_ALLOWGEO, QVariantMap());
+            ConfigStore::instance()->setValue(QUASAR_CONFIG_ALLOWGEO, QVariantMap());
         }
     });
     */
@@ -126,6 +136,7 @@ GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
     configLayout->addLayout(logLayout);
     configLayout->addLayout(cookieLayout);
     configLayout->addWidget(logToFile);
+    configLayout->addWidget(sharedRenderer);
 #ifdef WIN32
     configLayout->addWidget(startOnStartup);
 #endif
@@ -234,7 +245,7 @@ GeneralPage::GeneralPage(DataServices* service, QWidget* parent)
     setLayout(mainLayout);
 }
 
-void GeneralPage::saveSettings(QSettings& settings, bool& restartNeeded)
+void GeneralPage::saveSettings(ConfigStore& settings, bool& restartNeeded)
 {
     if (m_settingsModified)
     {
@@ -252,6 +263,13 @@ void GeneralPage::saveSettings(QSettings& settings, bool& restartNeeded)
             settings.setValue(QUASAR_CONFIG_COOKIES, cookieEdit->text());
         }
 
+        auto rendererCheck = findChild<QCheckBox*>(QUASAR_SETTING_RENDERER);
+
+        if (rendererCheck)
+        {
+            settings.setValue(QUASAR_CONFIG_SHAREDRENDERER, rendererCheck->isChecked());
+        }
+
         restartNeeded = true;
     }
 
@@ -269,6 +287,8 @@ void GeneralPage::saveSettings(QSettings& settings, bool& restartNeeded)
         settings.setValue(QUASAR_CONFIG_LOGFILE, logCheck->isChecked());
     }
 
+    LogWindow::reloadSettings();
+
 #ifdef WIN32
     auto startCheck = findChild<QCheckBox*>(QUASAR_SETTING_STARTUP);
 
@@ -343,7 +363,7 @@ PluginPage::PluginPage(DataServices* service, QWidget* parent)
     setLayout(mainLayout);
 }
 
-void PluginPage::saveSettings(QSettings& settings, bool& restartNeeded)
+void PluginPage::saveSettings(ConfigStore& settings, bool& restartNeeded)
 {
     auto pages = pagesWidget->children();
 
@@ -367,7 +387,7 @@ DataPluginPage::DataPluginPage(DataPlugin* p, QWidget* parent)
     // Create data source settings
     DataSourceMapType& sources = p->getDataSources();
 
-    QSettings settings;
+    ConfigStore& settings = *ConfigStore::instance();
 
     auto it = sources.begin();
 
@@ -495,7 +515,7 @@ DataPluginPage::DataPluginPage(DataPlugin* p, QWidget* parent)
     setLayout(mainLayout);
 }
 
-void DataPluginPage::saveSettings(QSettings& settings, bool& restartNeeded)
+void DataPluginPage::saveSettings(ConfigStore& settings, bool& restartNeeded)
 {
     // Save data source settings
     if (m_dataSettingsModified)
@@ -789,7 +809,7 @@ LauncherPage::LauncherPage(DataServices* service, QWidget* parent)
     setLayout(layout);
 }
 
-void LauncherPage::saveSettings(QSettings& settings, bool& restartNeeded)
+void LauncherPage::saveSettings(ConfigStore& settings, bool& restartNeeded)
 {
     auto table = findChild<QTableWidget*>();
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <QSettings>
+#include "configstore.h"
 #include <QWidget>
 
 QT_FORWARD_DECLARE_CLASS(DataPlugin)
@@ -17,7 +17,7 @@ public:
     PageWidget(QWidget* parent = 0)
         : QWidget(parent) {}
 
-    virtual void saveSettings(QSettings& settings, bool& restartNeeded) = 0;
+    virtual void saveSettings(ConfigStore& settings, bool& restartNeeded) = 0;
 };
 
 class GeneralPage : public PageWidget
@@ -27,7 +27,7 @@ class GeneralPage : public PageWidget
 public:
     GeneralPage(DataServices* service, QWidget* parent = 0);
 
-    virtual void saveSettings(QSettings& settings, bool& restartNeeded) override;
+    virtual void saveSettings(ConfigStore& settings, bool& restartNeeded) override;
 
 private slots:
     void pluginListClicked(QListWidgetItem* item);
@@ -51,7 +51,7 @@ class PluginPage : public PageWidget
 public:
     PluginPage(DataServices* service, QWidget* parent = 0);
 
-    virtual void saveSettings(QSettings& settings, bool& restartNeeded) override;
+    virtual void saveSettings(ConfigStore& settings, bool& restartNeeded) override;
 
 private:
     DataServices* m_service;
@@ -66,7 +66,7 @@ class DataPluginPage : public PageWidget
 public:
     DataPluginPage(DataPlugin* p, QWidget* parent = 0);
 
-    virtual void saveSettings(QSettings& settings, bool& restartNeeded) override;
+    virtual void saveSettings(ConfigStore& settings, bool& restartNeeded) override;
 
 private:
     bool m_dataSettingsModified = false;
@@ -80,7 +80,7 @@ class LauncherPage : public PageWidget
 public:
     LauncherPage(DataServices* service, QWidget* parent = 0);
 
-    virtual void saveSettings(QSettings& settings, bool& restartNeeded) override;
+    virtual void saveSettings(ConfigStore& settings, bool& restartNeeded) override;
 
 private:
     DataServices* m_service;
@@ -1,15 +1,36 @@
 #include "dataserver.h"
 
+#include "configstore.h"
 #include "dataplugin.h"
+#include "startupprofiler.h"
 #include "widgetdefs.h"
 
+#include <QDateTime>
 #include <QDir>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QSettings>
 #include <QtWebSockets/QWebSocket>
 #include <QtWebSockets/QWebSocketServer>
 
+namespace
+{
+    void write_le(char* out, quint64 val, int bytes)
+    {
+        for (int b = 0; b < bytes; b++)
+        {
+            out[b] = (char) ((val >> (8 * b)) & 0xFF);
+        }
+    }
+
+    void append_le(QByteArray& buf, quint64 val, int bytes)
+    {
+        int pos = buf.size();
+        buf.resize(pos + bytes);
+        write_le(buf.data() + pos, val, bytes);
+    }
+}
+
 DataServer::DataServer(QObject* parent)
     : QObject(parent), m_pWebSocketServer(nullptr)
 {
@@ -17,8 +38,7 @@ DataServer::DataServer(QObject* parent)
                                               QWebSocketServer::NonSecureMode,
                                               this);
 
-    QSettings settings;
-    quint16   port = settings.value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
+    quint16 port = ConfigStore::instance()->value(QUASAR_CONFIG_PORT, QUASAR_DATA_SERVER_DEFAULT_PORT).toUInt();
 
     if (!m_pWebSocketServer->listen(QHostAddress::LocalHost, port))
     {
@@ -33,13 +53,15 @@ DataServer::DataServer(QObject* parent)
     }
 
     using namespace std::placeholders;
-    m_reqcallmap["subscribe"] = std::bind(&DataServer::handleSubscribeReq, this, _1, _2);
-    m_reqcallmap["poll"]      = std::bind(&DataServer::handlePollReq, this, _1, _2);
+    addHandler("subscribe", std::bind(&DataServer::handleSubscribeReq, this, _1, _2));
+    addHandler("poll", std::bind(&DataServer::handlePollReq, this, _1, _2));
+    addHandler("history", std::bind(&DataServer::handleHistoryReq, this, _1, _2));
 }
 
 DataServer::~DataServer()
 {
-    m_reqcallmap.clear();
+    m_handlers.clear();
+    m_channels.clear();
 
     m_plugins.clear();
 
@@ -48,17 +70,62 @@ DataServer::~DataServer()
 
 bool DataServer::addHandler(QString type, HandlerFuncType handler)
 {
-    if (m_reqcallmap.count(type))
+    if (!m_reqtypes.emplace(type, m_handlers.size()).second)
     {
         qWarning() << "Handler for request type " << type << " already exists";
         return false;
     }
 
-    m_reqcallmap[type] = handler;
+    m_handlers.push_back(handler);
 
     return true;
 }
 
+void DataServer::setWidgetVisible(QString widgetName, bool visible)
+{
+    if (visible)
+    {
+        m_hiddenwidgets.erase(widgetName);
+    }
+    else
+    {
+        m_hiddenwidgets.insert(widgetName);
+    }
+
+    auto it = m_widgetsockets.find(widgetName);
+
+    if (it == m_widgetsockets.end())
+    {
+        return;
+    }
+
+    for (QWebSocket* socket : it->second)
+    {
+        for (auto& p : m_plugins)
+        {
+            if (visible)
+            {
+                p.second->resumeSubscriber(socket);
+            }
+            else
+            {
+                p.second->suspendSubscriber(socket);
+            }
+        }
+    }
+
+    qInfo() << "Data to widget " << widgetName << (visible ? " resumed" : " suspended");
+}
+
+void DataServer::registerWidgetSocket(QString widgetName, QWebSocket* socket)
+{
+    if (!m_socketwidget.count(socket))
+    {
+        m_socketwidget[socket] = widgetName;
+        m_widgetsockets[widgetName].insert(socket);
+    }
+}
+
 void DataServer::loadDataPlugins()
 {
     QDir          dir("plugins/");
@@ -79,7 +146,9 @@ void DataServer::loadDataPlugins()
 
         qInfo() << "Loading data plugin" << libpath;
 
+        StartupProfiler::begin("Plugin load: " + file.fileName());
         DataPlugin* plugin = DataPlugin::load(libpath, this);
+        StartupProfiler::end("Plugin load: " + file.fileName());
 
         if (!plugin)
         {
@@ -105,6 +174,22 @@ void DataServer::loadDataPlugins()
             delete plugin;
         }
     }
+
+    // Data source uids are dense, so channels are a flat table
+    for (auto& p : m_plugins)
+    {
+        for (auto& src : p.second->getDataSources())
+        {
+            size_t uid = src.second.uid;
+
+            if (uid >= m_channels.size())
+            {
+                m_channels.resize(uid + 1);
+            }
+
+            m_channels[uid] = { p.second.get(), &src.second };
+        }
+    }
 }
 
 void DataServer::handleRequest(const QJsonObject& req, QWebSocket* sender)
@@ -115,61 +200,298 @@ void DataServer::handleRequest(const QJsonObject& req, QWebSocket* sender)
         return;
     }
 
-    QString type = req["type"].toString();
+    QJsonValue type = req["type"];
+    qint64     id   = -1;
 
-    if (!m_reqcallmap.count(type))
+    // Compact clients send the interned id instead of the type name
+    if (type.isDouble())
+    {
+        id = type.toInt(-1);
+    }
+    else
     {
-        qWarning() << "Unknown request type";
+        auto it = m_reqtypes.find(type.toString());
+
+        if (it != m_reqtypes.end())
+        {
+            id = it->second;
+        }
+    }
+
+    if (id < 0 || id >= (qint64) m_handlers.size())
+    {
+        qWarning() << "Unknown request type " << type.toVariant().toString();
         return;
     }
 
-    m_reqcallmap[type](req, sender);
+    m_handlers[id](req, sender);
+}
+
+const DataChannel* DataServer::findChannel(const QJsonValue& id) const
+{
+    qint64 uid = id.toInt(-1);
+
+    if (uid < 0 || uid >= (qint64) m_channels.size() || !m_channels[uid].plugin)
+    {
+        return nullptr;
+    }
+
+    return &m_channels[uid];
+}
+
+bool DataServer::findSource(const QJsonObject& req, DataChannel& channel) const
+{
+    if (req.contains("channel"))
+    {
+        const DataChannel* ch = findChannel(req["channel"]);
+
+        if (!ch)
+        {
+            qWarning() << "Unknown channel " << req["channel"].toInt();
+            return false;
+        }
+
+        channel = *ch;
+        return true;
+    }
+
+    QString plugin = req["plugin"].toString();
+    QString source = req["source"].toString();
+
+    auto it = m_plugins.find(plugin);
+
+    if (it == m_plugins.end())
+    {
+        qWarning() << "Unknown plugin " << plugin;
+        return false;
+    }
+
+    DataSourceMapType& datasources = it->second->getDataSources();
+
+    auto sit = datasources.find(source);
+
+    if (sit == datasources.end())
+    {
+        qWarning() << "Unknown data source " << source << " requested in plugin " << plugin;
+        return false;
+    }
+
+    channel = { it->second.get(), &sit->second };
+    return true;
 }
 
 void DataServer::handleSubscribeReq(const QJsonObject& req, QWebSocket* sender)
 {
     QString widgetName = req["widget"].toString();
-    QString plugin     = req["plugin"].toString();
-    QString sources    = req["source"].toString();
+    bool    compact    = req["compact"].toBool();
+
+    std::vector<DataChannel> channels;
 
-    if (!m_plugins.count(plugin))
+    if (req.contains("channels"))
     {
-        qWarning() << "Unknown plugin " << plugin;
-        return;
+        // Subscribe by channel ids handed out earlier
+        for (const QJsonValue& id : req["channels"].toArray())
+        {
+            const DataChannel* ch = findChannel(id);
+
+            if (!ch)
+            {
+                qWarning() << "Widget " << widgetName << " requested unknown channel " << id.toInt();
+                continue;
+            }
+
+            channels.push_back(*ch);
+        }
     }
+    else
+    {
+        QString plugin  = req["plugin"].toString();
+        QString sources = req["source"].toString();
 
-    QStringList srclist = sources.split(',', QString::SkipEmptyParts);
+        auto it = m_plugins.find(plugin);
 
-    for (QString& src : srclist)
+        if (it == m_plugins.end())
+        {
+            qWarning() << "Unknown plugin " << plugin;
+            return;
+        }
+
+        DataPlugin*        dp          = it->second.get();
+        DataSourceMapType& datasources = dp->getDataSources();
+
+        QStringList srclist = sources.split(',', QString::SkipEmptyParts);
+
+        for (QString& src : srclist)
+        {
+            auto sit = datasources.find(src);
+
+            if (sit == datasources.end())
+            {
+                qWarning() << "Widget " << widgetName << " failed to subscribed to plugin " << plugin << " source " << src;
+                continue;
+            }
+
+            channels.push_back({ dp, &sit->second });
+        }
+    }
+
+    registerWidgetSocket(widgetName, sender);
+
+    // Widget is already hidden
+    bool hidden = m_hiddenwidgets.count(widgetName);
+
+    QJsonArray reply;
+
+    for (DataChannel& ch : channels)
     {
-        if (m_plugins[plugin]->addSubscriber(src, sender, widgetName))
+        bool first = ch.plugin->addSubscriber(*ch.source, sender, compact);
+
+        qInfo() << "Widget " << widgetName << " subscribed to plugin " << ch.plugin->getCode() << " source " << ch.source->key;
+
+        if (hidden)
         {
-            qInfo() << "Widget " << widgetName << " subscribed to plugin " << plugin << " source " << src;
+            // Fetched once the widget is shown again
+            ch.plugin->suspendSubscriber(sender);
         }
-        else
+        else if (first)
+        {
+            ch.plugin->fetchSignaledData(*ch.source);
+        }
+
+        if (compact)
         {
-            qWarning() << "Widget " << widgetName << " failed to subscribed to plugin " << plugin << " source " << src;
+            reply.append(QJsonObject{ { "plugin", ch.plugin->getCode() }, { "source", ch.source->key }, { "channel", (qint64) ch.source->uid } });
         }
     }
+
+    // Compact clients learn the ids to use from here on
+    if (compact)
+    {
+        QJsonObject types;
+
+        for (auto& t : m_reqtypes)
+        {
+            types[t.first] = (qint64) t.second;
+        }
+
+        QJsonObject msg{ { "type", "subscribed" }, { "channels", reply }, { "requests", types } };
+
+        sender->sendTextMessage(QString::fromUtf8(QJsonDocument(msg).toJson(QJsonDocument::Compact)));
+    }
 }
 
 void DataServer::handlePollReq(const QJsonObject& req, QWebSocket* sender)
 {
+    // Compact clients poll by channel id
+    if (req.contains("channel"))
+    {
+        const DataChannel* ch = findChannel(req["channel"]);
+
+        if (!ch)
+        {
+            qWarning() << "Unknown channel " << req["channel"].toInt();
+            return;
+        }
+
+        ch->plugin->addSubscriber(*ch->source, sender, true);
+        ch->plugin->pollAndSendData(*ch->source, sender);
+        return;
+    }
+
     QString widgetName = req["widget"].toString();
     QString plugin     = req["plugin"].toString();
     QString source     = req["source"].toString();
 
-    if (!m_plugins.count(plugin))
+    auto it = m_plugins.find(plugin);
+
+    if (it == m_plugins.end())
     {
         qWarning() << "Unknown plugin " << plugin;
         return;
     }
 
+    DataPlugin* dp = it->second.get();
+
     // Add client to poll queue
-    if (m_plugins[plugin]->addSubscriber(source, sender, widgetName))
+    if (dp->addSubscriber(source, sender, widgetName))
+    {
+        dp->pollAndSendData(source, sender, widgetName);
+    }
+}
+
+void DataServer::handleHistoryReq(const QJsonObject& req, QWebSocket* sender)
+{
+    DataChannel ch;
+
+    if (!findSource(req, ch))
+    {
+        return;
+    }
+
+    // The on-disk store covers everything the in-memory window does
+    const HistoryView* view = ch.source->store ? static_cast<const HistoryView*>(ch.source->store.get()) : ch.source->history.get();
+
+    bool   empty   = !view || view->isEmpty();
+    int    buckets = req["buckets"].toInt(0);
+    qint64 to      = req.contains("to") ? (qint64) req["to"].toDouble() : QDateTime::currentMSecsSinceEpoch();
+    qint64 from    = 0;
+
+    // Everything kept up to now unless a range is given. Starting at the oldest
+    // sample rather than the epoch keeps buckets spread over the data
+    if (req.contains("from"))
+    {
+        from = (qint64) req["from"].toDouble();
+    }
+    else if (!empty)
+    {
+        from = view->time(0);
+    }
+
+    if (buckets > 0)
+    {
+        QJsonObject msg{ { "type", "history" },
+                         { "plugin", ch.plugin->getCode() },
+                         { "source", ch.source->key },
+                         { "channel", (qint64) ch.source->uid },
+                         { "data", empty ? HistoryView::empty() : view->buckets(from, to, buckets) } };
+
+        sender->sendTextMessage(QString::fromUtf8(QJsonDocument(msg).toJson(QJsonDocument::Compact)));
+        return;
+    }
+
+    // Raw samples go out as a binary frame with the records copied straight from the
+    // history, at most QUASAR_HISTORY_MAX_SAMPLES per reply:
+    // [version][code len][code][source len][source] as in data frames, then little-endian
+    // [u32 channel][u32 columns][u32 records][i64 next][u32 names size], the column names
+    // in UTF-8 separated by '\n', zero padding to a multiple of 8 bytes, and the records
+    // as [i64 msec][double x columns] in host byte order. next is the "from" of the
+    // following page, -1 once the range is complete
+    QByteArray names   = empty ? QByteArray() : view->fields().join('\n').toUtf8();
+    quint32    columns = empty ? 0 : view->fields().size();
+
+    QByteArray frame;
+    frame.append((char) QUASAR_DP_HISTORY_VERSION).append(ch.source->blobheader.mid(1));
+    append_le(frame, ch.source->uid, 4);
+    append_le(frame, columns, 4);
+
+    int counts = frame.size();
+
+    append_le(frame, 0, 4);
+    append_le(frame, (quint64) -1, 8);
+    append_le(frame, names.size(), 4);
+    frame.append(names);
+    frame.append((8 - frame.size() % 8) % 8, '\0');
+
+    if (!empty)
     {
-        m_plugins[plugin]->pollAndSendData(source, sender, widgetName);
+        qint64 next    = -1;
+        size_t records = view->samples(from, to, QUASAR_HISTORY_MAX_SAMPLES, frame, next);
+
+        write_le(frame.data() + counts, records, 4);
+        write_le(frame.data() + counts + 4, (quint64) next, 8);
     }
+
+    sender->sendBinaryMessage(frame);
 }
 
 void DataServer::onNewConnection()
@@ -210,6 +532,26 @@ void DataServer::socketDisconnected()
             p.second->removeSubscriber(pClient);
         }
 
+        auto it = m_socketwidget.find(pClient);
+
+        if (it != m_socketwidget.end())
+        {
+            auto wit = m_widgetsockets.find(it->second);
+
+            if (wit != m_widgetsockets.end())
+            {
+                wit->second.erase(pClient);
+
+                if (wit->second.empty())
+                {
+                    m_hiddenwidgets.erase(wit->first);
+                    m_widgetsockets.erase(wit);
+                }
+            }
+
+            m_socketwidget.erase(it);
+        }
+
         pClient->deleteLater();
     }
 }
@@ -5,14 +5,25 @@
 #include <QObject>
 #include <functional>
 #include <memory>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 QT_FORWARD_DECLARE_CLASS(QWebSocketServer)
 QT_FORWARD_DECLARE_CLASS(QWebSocket)
 
 class DataPlugin;
+struct DataSource;
 
-using DataPluginMapType = std::unordered_map<QString, std::unique_ptr<DataPlugin>>;
+// Data source addressed by its channel id
+struct DataChannel
+{
+    DataPlugin* plugin = nullptr;
+    DataSource* source = nullptr;
+};
+
+using DataPluginMapType = QStringHashMap<std::unique_ptr<DataPlugin>>;
 using HandlerFuncType   = std::function<void(const QJsonObject&, QWebSocket*)>;
 
 class DataServer : public QObject
@@ -21,7 +32,8 @@ class DataServer : public QObject
 
     Q_OBJECT
 
-    using HandleReqCallMapType = std::unordered_map<QString, HandlerFuncType>;
+    using RequestTypeMapType  = QStringHashMap<size_t>;
+    using WidgetSocketMapType = QStringHashMap<std::set<QWebSocket*>>;
 
 public:
     ~DataServer();
@@ -30,12 +42,20 @@ public:
 
     bool addHandler(QString type, HandlerFuncType handler);
 
+public slots:
+    void setWidgetVisible(QString widgetName, bool visible);
+
 private:
     void loadDataPlugins();
+    void registerWidgetSocket(QString widgetName, QWebSocket* socket);
     void handleRequest(const QJsonObject& req, QWebSocket* sender);
 
+    const DataChannel* findChannel(const QJsonValue& id) const;
+    bool               findSource(const QJsonObject& req, DataChannel& channel) const;
+
     void handleSubscribeReq(const QJsonObject& req, QWebSocket* sender);
     void handlePollReq(const QJsonObject& req, QWebSocket* sender);
+    void handleHistoryReq(const QJsonObject& req, QWebSocket* sender);
 
 private slots:
     void onNewConnection();
@@ -49,7 +69,17 @@ private:
     DataServer& operator=(const DataServer&) = delete;
     DataServer& operator=(DataServer&&) = delete;
 
-    HandleReqCallMapType m_reqcallmap;
-    QWebSocketServer*    m_pWebSocketServer;
-    DataPluginMapType    m_plugins;
+    QWebSocketServer* m_pWebSocketServer;
+    DataPluginMapType m_plugins;
+
+    // Interned ids, request types index m_handlers and
+    // data source uids index m_channels
+    RequestTypeMapType           m_reqtypes;
+    std::vector<HandlerFuncType> m_handlers;
+    std::vector<DataChannel>     m_channels;
+
+    // Widget visibility tracking
+    WidgetSocketMapType                                    m_widgetsockets;
+    std::unordered_map<QWebSocket*, QString>               m_socketwidget;
+    std::unordered_set<QString, QStringHash, QStringEqual> m_hiddenwidgets;
 };
@@ -22,4 +22,7 @@ DataServices::DataServices(QObject* parent)
         throw std::runtime_error("Another instance already created");
     }
     s_service = this;
+
+    // Pause data to widgets that are hidden or occluded
+    connect(reg, &WidgetRegistry::widgetVisibilityChanged, server, &DataServer::setWidgetVisible);
 }
@@ -0,0 +1,152 @@
+#include "logmodel.h"
+
+#include <plugin_types.h>
+
+#include <QBrush>
+#include <QTimer>
+
+namespace
+{
+    // ~60 fps
+    constexpr int LOG_COMMIT_INTERVAL = 16;
+}
+
+LogModel::LogModel(int capacity, QObject* parent)
+    : QAbstractListModel(parent), m_ring(std::max(1, capacity))
+{
+    m_commitTimer = new QTimer(this);
+    m_commitTimer->setSingleShot(true);
+    m_commitTimer->setInterval(LOG_COMMIT_INTERVAL);
+
+    connect(m_commitTimer, &QTimer::timeout, this, &LogModel::commitPending);
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant LogModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_count)
+    {
+        return QVariant();
+    }
+
+    const LogModelEntry& entry = entryAt(index.row());
+
+    switch (role)
+    {
+        case Qt::DisplayRole:
+            return entry.text;
+
+        case Qt::ForegroundRole:
+            if (entry.level == QUASAR_LOG_CRITICAL)
+                return QBrush(Qt::red);
+            if (entry.level == QUASAR_LOG_WARNING)
+                return QBrush(QColor(200, 120, 0));
+            break;
+
+        case LevelRole:
+            return entry.level;
+
+        case SourceRole:
+            return entry.source;
+    }
+
+    return QVariant();
+}
+
+void LogModel::append(QVector<LogModelEntry> entries)
+{
+    for (LogModelEntry& e : entries)
+    {
+        auto it = m_sources.find(e.source);
+
+        if (it == m_sources.end())
+        {
+            it = m_sources.insert(e.source);
+            emit sourceAdded(e.source);
+        }
+
+        e.source = *it;
+    }
+
+    m_pending += entries;
+
+    if (!m_commitTimer->isActive())
+    {
+        m_commitTimer->start();
+    }
+}
+
+void LogModel::commitPending()
+{
+    const int capacity = m_ring.size();
+    int       n        = m_pending.size();
+    int       skip     = 0;
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    // Only the newest entries fit
+    if (n > capacity)
+    {
+        skip = n - capacity;
+        n    = capacity;
+    }
+
+    int overflow = m_count + n - capacity;
+
+    if (overflow > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        m_head = (m_head + overflow) % capacity;
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count + n - 1);
+
+    for (int i = 0; i < n; i++)
+    {
+        m_ring[(m_head + m_count + i) % capacity] = std::move(m_pending[skip + i]);
+    }
+
+    m_count += n;
+
+    endInsertRows();
+
+    m_pending.clear();
+}
+
+void LogFilterModel::setMinimumLevel(int level)
+{
+    m_minlevel = level;
+    invalidateFilter();
+}
+
+void LogFilterModel::setSource(QString source)
+{
+    m_source = source;
+    invalidateFilter();
+}
+
+bool LogFilterModel::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const
+{
+    QModelIndex idx = sourceModel()->index(source_row, 0, source_parent);
+
+    if (sourceModel()->data(idx, LogModel::LevelRole).toInt() < m_minlevel)
+    {
+        return false;
+    }
+
+    if (!m_source.isEmpty() && sourceModel()->data(idx, LogModel::SourceRole).toString() != m_source)
+    {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+struct LogModelEntry
+{
+    int     level; // quasar_log_level_t
+    QString source;
+    QString text;
+};
+
+Q_DECLARE_METATYPE(LogModelEntry);
+
+// Ring buffer backed model of log messages.
+// Appends are staged and committed to views at most once per frame
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum LogRoles
+    {
+        LevelRole = Qt::UserRole + 1,
+        SourceRole
+    };
+
+    explicit LogModel(int capacity, QObject* parent = Q_NULLPTR);
+    LogModel(const LogModel&) = delete;
+    LogModel& operator=(const LogModel&) = delete;
+
+    virtual int      rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void append(QVector<LogModelEntry> entries);
+
+signals:
+    void sourceAdded(QString source);
+
+private slots:
+    void commitPending();
+
+private:
+    const LogModelEntry& entryAt(int row) const { return m_ring[(m_head + row) % m_ring.size()]; }
+
+    QVector<LogModelEntry> m_ring;
+    int                    m_head  = 0;
+    int                    m_count = 0;
+
+    QVector<LogModelEntry> m_pending;
+    QTimer*                m_commitTimer;
+
+    // Interned source names so entries share string data
+    QSet<QString> m_sources;
+};
+
+class LogFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit LogFilterModel(QObject* parent = Q_NULLPTR)
+        : QSortFilterProxyModel(parent) {}
+
+    void setMinimumLevel(int level);
+    void setSource(QString source);
+
+protected:
+    virtual bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
+
+private:
+    int     m_minlevel = 0;
+    QString m_source;
+};
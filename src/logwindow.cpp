@@ -1,15 +1,27 @@
 #include "logwindow.h"
 
+#include "configstore.h"
+#include "logmodel.h"
 #include "widgetdefs.h"
 #include <plugin_types.h>
 
+#include <QComboBox>
 #include <QFile>
-#include <QSettings>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QListView>
+#include <QScrollBar>
 #include <QStandardPaths>
-#include <QTextEdit>
 #include <QTextStream>
+#include <QVBoxLayout>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <mutex>
+#include <thread>
 
 /*
 * This is a fake singleton unique pointer hybrid monster thing
@@ -20,9 +32,130 @@
 
 namespace
 {
-    std::mutex            s_logMutex;
-    QTextEdit*            s_logEdit = nullptr;
+    struct LogEntry
+    {
+        QtMsgType type;
+        int       level;
+        QString   source;
+        QString   text;
+    };
+
+    // Bounded lock-free queue (D. Vyukov). Any number of threads may push,
+    // only the log writer thread pops
+    template <typename T, size_t N>
+    class LogQueue
+    {
+        static_assert((N & (N - 1)) == 0, "LogQueue size must be a power of 2");
+
+        struct Cell
+        {
+            std::atomic<size_t> seq;
+            T                   data;
+        };
+
+    public:
+        LogQueue()
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                m_buffer[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(T&& val)
+        {
+            Cell*  cell;
+            size_t pos = m_enqueue.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                cell          = &m_buffer[pos & (N - 1)];
+                size_t   seq  = cell->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+                if (diff == 0)
+                {
+                    if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // full
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueue.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->data = std::move(val);
+            cell->seq.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool pop(T& val)
+        {
+            Cell*  cell;
+            size_t pos = m_dequeue.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                cell          = &m_buffer[pos & (N - 1)];
+                size_t   seq  = cell->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t)(pos + 1);
+
+                if (diff == 0)
+                {
+                    if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // empty
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeue.load(std::memory_order_relaxed);
+                }
+            }
+
+            val = std::move(cell->data);
+            cell->seq.store(pos + N, std::memory_order_release);
+
+            return true;
+        }
+
+    private:
+        std::array<Cell, N> m_buffer;
+
+        alignas(64) std::atomic<size_t> m_enqueue{ 0 };
+        alignas(64) std::atomic<size_t> m_dequeue{ 0 };
+    };
+
+    // Writer wakes up at this interval to batch out queued messages
+    constexpr auto LOG_FLUSH_INTERVAL = std::chrono::milliseconds(50);
+
+    // Entries kept in the log viewer
+    constexpr int LOG_HISTORY_SIZE = 20000;
+
+    LogWindow*            s_logWindow = nullptr;
+    QWidget*              s_logView   = nullptr;
+    LogModel*             s_logModel  = nullptr;
     QScopedPointer<QFile> s_logFile;
+
+    std::atomic<int>    s_logLevel{ QUASAR_CONFIG_DEFAULT_LOGLEVEL };
+    std::atomic<bool>   s_logToFile{ false };
+    std::atomic<size_t> s_dropped{ 0 };
+
+    LogQueue<LogEntry, 4096> s_logQueue;
+
+    std::thread             s_writer;
+    std::atomic<bool>       s_writerStop{ false };
+    std::mutex              s_writerMutex;
+    std::condition_variable s_writerCv;
 }
 
 void open_log_file()
@@ -47,12 +180,107 @@ void open_log_file()
     }
 }
 
+void flush_log_queue()
+{
+    // Only ever called from the writer thread, or synchronously on a fatal message
+    QString                batch;
+    QVector<LogModelEntry> entries;
+    LogEntry               entry;
+
+    while (s_logQueue.pop(entry))
+    {
+        batch.append(entry.text);
+        batch.append('\n');
+
+        entries.append({ entry.level, std::move(entry.source), std::move(entry.text) });
+    }
+
+    size_t dropped = s_dropped.exchange(0, std::memory_order_relaxed);
+
+    if (dropped > 0)
+    {
+        QString msg = QString("[%1 log messages dropped]").arg(dropped);
+
+        batch.append(msg);
+        batch.append('\n');
+
+        entries.append({ QUASAR_LOG_WARNING, "quasar", msg });
+    }
+
+    if (batch.isEmpty())
+    {
+        return;
+    }
+
+    if (s_logToFile.load(std::memory_order_relaxed))
+    {
+        if (!s_logFile)
+        {
+            open_log_file();
+        }
+
+        QTextStream out(s_logFile.data());
+        out << batch;
+        out.flush();
+    }
+
+    if (s_logWindow)
+    {
+        // Models may only be touched from the GUI thread
+        QMetaObject::invokeMethod(s_logWindow, "appendEntries", Qt::QueuedConnection, Q_ARG(QVector<LogModelEntry>, entries));
+    }
+}
+
+int log_level_for(QtMsgType type)
+{
+    switch (type)
+    {
+        case QtDebugMsg:
+            return QUASAR_LOG_DEBUG;
+        case QtInfoMsg:
+            return QUASAR_LOG_INFO;
+        case QtWarningMsg:
+            return QUASAR_LOG_WARNING;
+        default:
+            return QUASAR_LOG_CRITICAL;
+    }
+}
+
+QString log_source_for(const QMessageLogContext& context, const QString& msg)
+{
+    // Plugin messages come through quasar_log() prefixed with "<plugin code>: "
+    if (context.function && strstr(context.function, "quasar_log"))
+    {
+        int idx = msg.indexOf(QLatin1String(": "));
+
+        if (idx > 0)
+        {
+            return msg.left(idx);
+        }
+    }
+
+    return QStringLiteral("quasar");
+}
+
+void log_writer_thread()
+{
+    while (!s_writerStop.load(std::memory_order_acquire))
+    {
+        {
+            std::unique_lock<std::mutex> lock(s_writerMutex);
+            s_writerCv.wait_for(lock, LOG_FLUSH_INTERVAL, [] { return s_writerStop.load(std::memory_order_acquire); });
+        }
+
+        flush_log_queue();
+    }
+
+    flush_log_queue();
+}
+
 void msg_handler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
-    QSettings setting;
-    int       loglevel = setting.value(QUASAR_CONFIG_LOGLEVEL, QUASAR_CONFIG_DEFAULT_LOGLEVEL).toInt();
-    bool      logFile  = setting.value(QUASAR_CONFIG_LOGFILE, false).toBool();
-    bool      print    = false;
+    int  loglevel = s_logLevel.load(std::memory_order_relaxed);
+    bool print    = false;
 
     switch (type)
     {
@@ -79,67 +307,153 @@ void msg_handler(QtMsgType type, const QMessageLogContext& context, const QStrin
 
     if (print)
     {
-        std::unique_lock<std::mutex> lock(s_logMutex);
-
-        QString output = qFormatLogMessage(type, context, msg);
-
-        if (s_logEdit)
+        // context is only valid for the duration of this call
+        if (!s_logQueue.push({ type, log_level_for(type), log_source_for(context, msg), qFormatLogMessage(type, context, msg) }))
         {
-            s_logEdit->append(output);
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
         }
 
-        if (logFile && !s_logFile)
+        if (type == QtFatalMsg)
         {
-            open_log_file();
-        }
+            // About to abort, so get everything out now
+            s_writerStop.store(true, std::memory_order_release);
+            s_writerCv.notify_one();
 
-        if (s_logFile)
-        {
-            QTextStream out(s_logFile.data());
-            out << output << endl;
-            out.flush();
+            if (s_writer.joinable() && s_writer.get_id() != std::this_thread::get_id())
+            {
+                s_writer.join();
+            }
+
+            flush_log_queue();
         }
     }
 }
 
 LogWindow::~LogWindow()
 {
-    // if released, s_logEdit is not owned anymore
+    qInstallMessageHandler(nullptr);
+
+    s_writerStop.store(true, std::memory_order_release);
+    s_writerCv.notify_one();
+
+    if (s_writer.joinable())
+    {
+        s_writer.join();
+    }
+
+    s_logWindow = nullptr;
+    s_logFile.reset();
+
+    // if released, s_logView is not owned anymore
     // otherwise it needs to be cleaned
-    if (!m_released && nullptr != s_logEdit)
+    if (!m_released && nullptr != s_logView)
     {
-        delete s_logEdit;
+        delete s_logView;
     }
 
-    s_logEdit = nullptr;
+    s_logView  = nullptr;
+    s_logModel = nullptr;
 }
 
 LogWindow::LogWindow(QObject* parent)
     : QObject(parent)
 {
-    if (nullptr != s_logEdit)
+    if (nullptr != s_logView)
     {
         throw std::runtime_error("log window already created");
     }
 
-    s_logEdit = new QTextEdit();
+    qRegisterMetaType<QVector<LogModelEntry>>();
+
+    s_logWindow = this;
+    s_logView   = new QWidget();
+    s_logModel  = new LogModel(LOG_HISTORY_SIZE, s_logView);
 
-    s_logEdit->setReadOnly(true);
-    s_logEdit->setAcceptRichText(true);
+    auto filter = new LogFilterModel(s_logView);
+    filter->setSourceModel(s_logModel);
 
-    // max lines in log viewer
-    s_logEdit->document()->setMaximumBlockCount(250);
+    auto list = new QListView(s_logView);
+    list->setModel(filter);
+    list->setUniformItemSizes(true);
+    list->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+
+    auto levelCombo = new QComboBox(s_logView);
+    levelCombo->addItem(tr("Debug"), QUASAR_LOG_DEBUG);
+    levelCombo->addItem(tr("Info"), QUASAR_LOG_INFO);
+    levelCombo->addItem(tr("Warning"), QUASAR_LOG_WARNING);
+    levelCombo->addItem(tr("Critical"), QUASAR_LOG_CRITICAL);
+
+    auto sourceCombo = new QComboBox(s_logView);
+    sourceCombo->addItem(tr("All"), QString());
+    sourceCombo->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+
+    connect(levelCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), filter, [=](int) {
+        filter->setMinimumLevel(levelCombo->currentData().toInt());
+    });
+
+    connect(sourceCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), filter, [=](int) {
+        filter->setSource(sourceCombo->currentData().toString());
+    });
+
+    connect(s_logModel, &LogModel::sourceAdded, sourceCombo, [=](QString source) {
+        sourceCombo->addItem(source, source);
+    });
+
+    // Follow new messages unless the user has scrolled up
+    connect(filter, &QAbstractItemModel::rowsAboutToBeInserted, list, [=] {
+        m_follow = (list->verticalScrollBar()->value() == list->verticalScrollBar()->maximum());
+    });
+
+    connect(filter, &QAbstractItemModel::rowsInserted, list, [=] {
+        if (m_follow)
+        {
+            list->scrollToBottom();
+        }
+    });
+
+    auto filterLayout = new QHBoxLayout();
+    filterLayout->addWidget(new QLabel(tr("Level:"), s_logView));
+    filterLayout->addWidget(levelCombo);
+    filterLayout->addWidget(new QLabel(tr("Source:"), s_logView));
+    filterLayout->addWidget(sourceCombo);
+    filterLayout->addStretch();
+
+    auto layout = new QVBoxLayout(s_logView);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(filterLayout);
+    layout->addWidget(list);
+
+    reloadSettings();
+
+    s_writerStop.store(false, std::memory_order_release);
+    s_writer = std::thread(log_writer_thread);
 
     qInstallMessageHandler(msg_handler);
     qSetMessagePattern("[%{time}]    %{type}    %{message} - (%{function}:%{line})");
 }
 
-QTextEdit* LogWindow::release()
+QWidget* LogWindow::release()
 {
-    if (nullptr != s_logEdit)
+    if (nullptr != s_logView)
     {
         m_released = true;
     }
 
-    return s_logEdit;
+    return s_logView;
+}
+
+void LogWindow::reloadSettings()
+{
+    ConfigStore& setting = *ConfigStore::instance();
+    s_logLevel.store(setting.value(QUASAR_CONFIG_LOGLEVEL, QUASAR_CONFIG_DEFAULT_LOGLEVEL).toInt(), std::memory_order_relaxed);
+    s_logToFile.store(setting.value(QUASAR_CONFIG_LOGFILE, false).toBool(), std::memory_order_relaxed);
+}
+
+void LogWindow::appendEntries(QVector<LogModelEntry> entries)
+{
+    if (s_logModel)
+    {
+        s_logModel->append(std::move(entries));
+    }
 }
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <QObject>
+#include "logmodel.h"
 
-QT_FORWARD_DECLARE_CLASS(QTextEdit)
+#include <QObject>
 
 class LogWindow : public QObject
 {
@@ -16,8 +16,14 @@ public:
     LogWindow& operator=(const LogWindow&) = delete;
     LogWindow& operator=(LogWindow&&) = delete;
 
-    QTextEdit* release();
+    QWidget* release();
+
+    static void reloadSettings();
+
+private slots:
+    void appendEntries(QVector<LogModelEntry> entries);
 
 private:
     bool m_released = false;
+    bool m_follow   = true;
 };
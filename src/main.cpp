@@ -1,24 +1,84 @@
+#include "configstore.h"
 #include "dataservices.h"
 #include "logwindow.h"
 #include "quasar.h"
 #include "runguard.h"
+#include "startupprofiler.h"
 #include "widgetdefs.h"
 #include "widgetregistry.h"
 
+#include <QCommandLineParser>
+#include <QJsonDocument>
 #include <QSettings>
 #include <QSplashScreen>
+#include <QTextStream>
 #include <QtWebEngineWidgets/QWebEngineProfile>
 #include <QtWidgets/QApplication>
 
+namespace
+{
+    void setupRendererFlags()
+    {
+        // Must be done before QtWebEngine is initialized
+        QSettings settings;
+
+        if (!settings.value(QUASAR_CONFIG_SHAREDRENDERER, false).toBool())
+        {
+            return;
+        }
+
+        QByteArray flags = qgetenv("QTWEBENGINE_CHROMIUM_FLAGS");
+
+        // Host all pages of the same site (i.e. every local file:// widget)
+        // in a single shared renderer process instead of one per widget.
+        // The switch is global, widgets with remote access are kept out of
+        // the shared process by giving them their own profile (see WidgetRegistry)
+        flags.append(" --process-per-site");
+
+        int limit = settings.value(QUASAR_CONFIG_RENDERERLIMIT, 0).toInt();
+
+        if (limit > 0)
+        {
+            flags.append(" --renderer-process-limit=" + QByteArray::number(limit));
+        }
+
+        qputenv("QTWEBENGINE_CHROMIUM_FLAGS", flags.trimmed());
+    }
+}
+
 int main(int argc, char* argv[])
 {
+    StartupProfiler::start();
+
     RunGuard guard("quasar_app_key");
     if (!guard.tryToRun())
         return 0;
 
+    QApplication::setApplicationName("Quasar");
+    QApplication::setOrganizationName("Quasar");
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+
+    setupRendererFlags();
+
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
+
+    StartupProfiler::begin("QApplication");
     QApplication a(argc, argv);
     a.setQuitOnLastWindowClosed(false);
+    StartupProfiler::end("QApplication");
+
+    // Chromium switches are passed on the same command line, so ignore unknown options
+    QCommandLineOption benchmarkOption("startup-benchmark", "Print a startup timing report and exit once all widgets have loaded.");
+    QCommandLineParser parser;
+    parser.addOption(benchmarkOption);
+    parser.parse(a.arguments());
+
+    bool benchmark = parser.isSet(benchmarkOption);
+
+    // Settings are read once here, everything else works off memory
+    StartupProfiler::begin("Configuration");
+    ConfigStore config;
+    StartupProfiler::end("Configuration");
 
     LogWindow* log = new LogWindow();
 
@@ -31,35 +91,49 @@ int main(int argc, char* argv[])
     splash.showMessage("Loading configuration...", align, color);
     a.processEvents();
 
-    QApplication::setApplicationName("Quasar");
-    QApplication::setOrganizationName("Quasar");
-    QSettings::setDefaultFormat(QSettings::IniFormat);
-
+    StartupProfiler::begin("WebEngine profile");
     QWebEngineProfile::defaultProfile()->setPersistentCookiesPolicy(QWebEngineProfile::NoPersistentCookies);
+    StartupProfiler::end("WebEngine profile");
 
     splash.showMessage("Loading services...", align, color);
     a.processEvents();
 
     // preload
     // Quasar takes ownership
+    StartupProfiler::begin("Services");
     DataServices* service = new DataServices();
+    StartupProfiler::end("Services");
 
+    StartupProfiler::begin("Main window");
     Quasar w(log, service);
     w.hide();
+    StartupProfiler::end("Main window");
 
-    splash.showMessage("Loading widgets...", align, color);
-    a.processEvents();
+    splash.finish(&w);
 
-    // Load widgets
-    QSettings   settings;
-    QStringList loadedList = settings.value(QUASAR_CONFIG_LOADED).toStringList();
+    QObject::connect(service->getRegistry(), &WidgetRegistry::widgetsLoaded, &a, [benchmark] {
+        if (!StartupProfiler::isRecording())
+        {
+            return;
+        }
 
-    for (const QString& f : loadedList)
-    {
-        service->getRegistry()->loadWebWidget(f, false);
-    }
+        StartupProfiler::finish();
 
-    splash.finish(&w);
+        QJsonObject report = StartupProfiler::report();
+
+        qInfo() << "Startup finished in" << report["total"].toDouble() << "ms";
+
+        if (benchmark)
+        {
+            QTextStream(stdout) << QJsonDocument(report).toJson(QJsonDocument::Indented);
+            QCoreApplication::exit(0);
+        }
+    });
+
+    // Load widgets in the background
+    QStringList loadedList = config.value(QUASAR_CONFIG_LOADED).toStringList();
+
+    service->getRegistry()->loadWebWidgets(loadedList);
 
     return a.exec();
 }
@@ -4,6 +4,7 @@
 #include "version.h"
 
 #include "configdialog.h"
+#include "configstore.h"
 #include "dataservices.h"
 #include "logwindow.h"
 #include "webwidget.h"
@@ -62,8 +63,8 @@ Quasar::Quasar(LogWindow* log, DataServices* s, QWidget* parent)
 
 void Quasar::openWebWidget()
 {
-    QSettings settings;
-    QString   lastpath = settings.value(QUASAR_CONFIG_LASTPATH, QDir::currentPath()).toString();
+    ConfigStore& settings = *ConfigStore::instance();
+    QString      lastpath = settings.value(QUASAR_CONFIG_LASTPATH, QDir::currentPath()).toString();
 
     QString fname = QFileDialog::getOpenFileName(this, tr("Load Widget"), lastpath, tr("Widget Definitions (*.json)"));
 
@@ -0,0 +1,134 @@
+#include "startupprofiler.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QMutex>
+#include <QVector>
+
+namespace
+{
+    struct StartupPhase
+    {
+        QString name;
+        qint64  start;
+        qint64  end;
+    };
+
+    QElapsedTimer         s_clock;
+    QMutex                s_mutex;
+    QVector<StartupPhase> s_phases;
+    QVector<StartupPhase> s_events;
+    qint64                s_finished = -1;
+
+    double to_msec(qint64 nsec)
+    {
+        return nsec / 1000000.0;
+    }
+}
+
+void StartupProfiler::start()
+{
+    QMutexLocker lock(&s_mutex);
+
+    s_clock.start();
+    s_finished = -1;
+}
+
+void StartupProfiler::finish()
+{
+    QMutexLocker lock(&s_mutex);
+
+    if (s_clock.isValid() && s_finished < 0)
+    {
+        s_finished = s_clock.nsecsElapsed();
+    }
+}
+
+bool StartupProfiler::isRecording()
+{
+    QMutexLocker lock(&s_mutex);
+
+    return s_clock.isValid() && s_finished < 0;
+}
+
+void StartupProfiler::begin(const QString& phase)
+{
+    QMutexLocker lock(&s_mutex);
+
+    if (s_clock.isValid() && s_finished < 0)
+    {
+        s_phases.append({ phase, s_clock.nsecsElapsed(), -1 });
+    }
+}
+
+void StartupProfiler::end(const QString& phase)
+{
+    QMutexLocker lock(&s_mutex);
+
+    if (!s_clock.isValid() || s_finished >= 0)
+    {
+        return;
+    }
+
+    // Close the most recent open phase with this name
+    for (auto it = s_phases.rbegin(); it != s_phases.rend(); ++it)
+    {
+        if (it->end < 0 && it->name == phase)
+        {
+            it->end = s_clock.nsecsElapsed();
+            break;
+        }
+    }
+}
+
+void StartupProfiler::mark(const QString& event)
+{
+    QMutexLocker lock(&s_mutex);
+
+    if (s_clock.isValid() && s_finished < 0)
+    {
+        qint64 now = s_clock.nsecsElapsed();
+        s_events.append({ event, now, now });
+    }
+}
+
+QJsonObject StartupProfiler::report()
+{
+    QMutexLocker lock(&s_mutex);
+
+    QJsonArray phases;
+
+    for (const StartupPhase& p : s_phases)
+    {
+        QJsonObject o;
+        o["name"]  = p.name;
+        o["start"] = to_msec(p.start);
+
+        // Unfinished phases are reported without a duration
+        if (p.end >= 0)
+        {
+            o["duration"] = to_msec(p.end - p.start);
+        }
+
+        phases.append(o);
+    }
+
+    QJsonArray events;
+
+    for (const StartupPhase& e : s_events)
+    {
+        QJsonObject o;
+        o["name"] = e.name;
+        o["at"]   = to_msec(e.start);
+
+        events.append(o);
+    }
+
+    QJsonObject rep;
+    rep["units"]  = "ms";
+    rep["total"]  = to_msec(s_finished >= 0 ? s_finished : s_clock.nsecsElapsed());
+    rep["phases"] = phases;
+    rep["events"] = events;
+
+    return rep;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+// Records how long each startup phase takes, relative to process start.
+// Recording stops once finish() is called, later calls are no-ops.
+class StartupProfiler
+{
+public:
+    static void start();
+    static void finish();
+    static bool isRecording();
+
+    static void begin(const QString& phase);
+    static void end(const QString& phase);
+
+    // Single point in time, i.e. first paint of a widget
+    static void mark(const QString& event);
+
+    static QJsonObject report();
+};
@@ -1,5 +1,7 @@
 #include "webwidget.h"
 
+#include "configstore.h"
+#include "startupprofiler.h"
 #include "widgetdefs.h"
 
 #include <QAction>
@@ -9,6 +11,64 @@
 #include <QtWebEngineWidgets/QWebEngineScriptCollection>
 #include <QtWebEngineWidgets/QWebEngineSettings>
 
+#ifdef Q_OS_WIN
+#    define NOMINMAX
+#    include <Windows.h>
+#    include <dwmapi.h>
+#endif
+
+namespace
+{
+#ifdef Q_OS_WIN
+    bool isCloaked(HWND hwnd)
+    {
+        DWORD cloaked = 0;
+        return SUCCEEDED(DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked;
+    }
+
+    // With DWM composition a covered window stays exposed, so subtract every opaque
+    // top-level window above it in z-order from its rectangle and see if anything is left
+    bool isOccluded(HWND hwnd)
+    {
+        RECT rect;
+
+        if (isCloaked(hwnd))
+        {
+            return true;
+        }
+
+        if (!GetWindowRect(hwnd, &rect))
+        {
+            return false;
+        }
+
+        HRGN visible = CreateRectRgnIndirect(&rect);
+        HRGN above   = CreateRectRgn(0, 0, 0, 0);
+        int  type    = SIMPLEREGION;
+
+        for (HWND w = GetWindow(hwnd, GW_HWNDPREV); w && type != NULLREGION; w = GetWindow(w, GW_HWNDPREV))
+        {
+            LONG exstyle = GetWindowLong(w, GWL_EXSTYLE);
+            RECT r;
+
+            // Layered and click-through windows may be see-through, so never count them
+            if (!IsWindowVisible(w) || IsIconic(w) || isCloaked(w) || (exstyle & (WS_EX_LAYERED | WS_EX_TRANSPARENT)) || !GetWindowRect(w, &r))
+            {
+                continue;
+            }
+
+            SetRectRgn(above, r.left, r.top, r.right, r.bottom);
+            type = CombineRgn(visible, visible, above, RGN_DIFF);
+        }
+
+        DeleteObject(above);
+        DeleteObject(visible);
+
+        return type == NULLREGION;
+    }
+#endif
+}
+
 QString WebWidget::PageGlobalTemp;
 
 void QuasarWebPage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString& message, int lineNumber, const QString& sourceID)
@@ -29,7 +89,7 @@ void QuasarWebPage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level
     }
 }
 
-WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent)
+WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWebEngineProfile* profile, QWidget* parent)
     : QWidget(parent), m_Name(widgetName)
 {
     if (m_Name.isEmpty())
@@ -45,6 +105,12 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent
 
     webview = new QuasarWebView(this);
 
+    if (StartupProfiler::isRecording())
+    {
+        // Watch for the view's render widget to catch the first paint
+        webview->installEventFilter(this);
+    }
+
     QString entryPath = data[WGT_DEF_STARTFILE].toString();
     QUrl    startFile;
 
@@ -60,7 +126,17 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent
         startFile             = QUrl::fromLocalFile(startFilePath.append(entryPath));
     }
 
-    QuasarWebPage* page = new QuasarWebPage(this);
+    QuasarWebPage* page = profile ? new QuasarWebPage(profile, this) : new QuasarWebPage(this);
+
+    if (profile)
+    {
+        // The page must go before its profile
+        profile->setParent(page);
+    }
+
+    connect(page, &QWebEnginePage::loadFinished, [this](bool ok) {
+        emit WebWidgetLoadFinished(this, ok);
+    });
     page->load(startFile);
     webview->setPage(page);
 
@@ -85,9 +161,9 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent
         if (feature != QWebEnginePage::Geolocation)
             return;
 
-        QSettings settings;
-        auto      allowgeo = settings.value(QUASAR_CONFIG_ALLOWGEO).toMap();
-        auto      perm     = QWebEnginePage::PermissionDeniedByUser;
+        ConfigStore& settings = *ConfigStore::instance();
+        auto         allowgeo = settings.value(QUASAR_CONFIG_ALLOWGEO).toMap();
+        auto         perm     = QWebEnginePage::PermissionDeniedByUser;
 
         if (allowgeo.contains(data[WGT_DEF_FULLPATH].toString()))
         {
@@ -123,6 +199,38 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent
     });
     */
 
+    // Freeze pages that stay hidden, without flapping on transient hides
+    m_freezeTimer = new QTimer(this);
+    m_freezeTimer->setSingleShot(true);
+    m_freezeTimer->setInterval(QUASAR_WIDGET_FREEZE_DELAY);
+    connect(m_freezeTimer, &QTimer::timeout, [this] {
+        if (m_pageActive && !isExposed())
+        {
+            setPageActive(false);
+            emit WebWidgetVisibilityChanged(this, false);
+        }
+    });
+
+    // Discard pages that have been frozen for too long
+    m_discardTimer = new QTimer(this);
+    m_discardTimer->setSingleShot(true);
+    connect(m_discardTimer, &QTimer::timeout, [this] {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        if (!m_pageActive)
+        {
+            qInfo() << "Discarding hidden widget " << m_Name;
+            webview->page()->setLifecycleState(QWebEnginePage::LifecycleState::Discarded);
+        }
+#endif
+    });
+
+#ifdef Q_OS_WIN
+    // Windows sends no expose events for covered windows, so check for occlusion
+    m_occlusionTimer = new QTimer(this);
+    m_occlusionTimer->setInterval(QUASAR_WIDGET_OCCLUSION_INTERVAL);
+    connect(m_occlusionTimer, &QTimer::timeout, this, &WebWidget::updateVisibility);
+#endif
+
     // Overlay for catching drag and drop events
     overlay = new OverlayWidget(this);
 
@@ -131,7 +239,7 @@ WebWidget::WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent
     createContextMenu();
 
     // Restore settings
-    QSettings settings;
+    ConfigStore& settings = *ConfigStore::instance();
     restoreGeometry(settings.value(getSettingKey("geometry")).toByteArray());
     bool ontop      = settings.value(getSettingKey("alwaysOnTop")).toBool();
     m_fixedposition = settings.value(getSettingKey("fixedPosition")).toBool();
@@ -242,7 +350,7 @@ QString WebWidget::getFullPath()
 
 void WebWidget::saveSettings()
 {
-    QSettings settings;
+    ConfigStore& settings = *ConfigStore::instance();
     settings.setValue(getSettingKey("geometry"), saveGeometry());
     settings.setValue(getSettingKey("alwaysOnTop"), rOnTop->isChecked());
     settings.setValue(getSettingKey("fixedPosition"), m_fixedposition);
@@ -287,8 +395,8 @@ void WebWidget::createContextMenuActions()
     rClose = new QAction(tr("&Close"), this);
     connect(rClose, &QAction::triggered, [=] {
         // Remove from loaded
-        QSettings   settings;
-        QStringList loaded = settings.value(QUASAR_CONFIG_LOADED).toStringList();
+        ConfigStore& settings = *ConfigStore::instance();
+        QStringList  loaded   = settings.value(QUASAR_CONFIG_LOADED).toStringList();
         loaded.removeOne(getFullPath());
         settings.setValue(QUASAR_CONFIG_LOADED, loaded);
 
@@ -330,6 +438,138 @@ void WebWidget::mouseMoveEvent(QMouseEvent* evt)
     }
 }
 
+void WebWidget::showEvent(QShowEvent* evt)
+{
+    QWidget::showEvent(evt);
+
+    // Track exposure of the native window to catch occlusion
+    if (windowHandle())
+    {
+        windowHandle()->removeEventFilter(this);
+        windowHandle()->installEventFilter(this);
+    }
+
+#ifdef Q_OS_WIN
+    m_occlusionTimer->start();
+#endif
+
+    // Otherwise wait for the expose event
+    if (isExposed())
+    {
+        updateVisibility();
+    }
+}
+
+void WebWidget::hideEvent(QHideEvent* evt)
+{
+    QWidget::hideEvent(evt);
+
+#ifdef Q_OS_WIN
+    m_occlusionTimer->stop();
+#endif
+
+    updateVisibility();
+}
+
+void WebWidget::changeEvent(QEvent* evt)
+{
+    QWidget::changeEvent(evt);
+
+    if (evt->type() == QEvent::WindowStateChange)
+    {
+        updateVisibility();
+    }
+}
+
+bool WebWidget::eventFilter(QObject* obj, QEvent* evt)
+{
+    if (obj == windowHandle() && evt->type() == QEvent::Expose)
+    {
+        // Let the window process the expose first
+        QTimer::singleShot(0, this, &WebWidget::updateVisibility);
+    }
+    else if (obj == webview && evt->type() == QEvent::ChildAdded)
+    {
+        static_cast<QChildEvent*>(evt)->child()->installEventFilter(this);
+    }
+    else if (evt->type() == QEvent::Paint && obj->parent() == webview)
+    {
+        StartupProfiler::mark("Widget first paint: " + m_Name);
+
+        obj->removeEventFilter(this);
+        webview->removeEventFilter(this);
+    }
+
+    return QWidget::eventFilter(obj, evt);
+}
+
+bool WebWidget::isExposed()
+{
+    if (!isVisible() || isMinimized() || !windowHandle() || !windowHandle()->isExposed())
+    {
+        return false;
+    }
+
+#ifdef Q_OS_WIN
+    return !isOccluded((HWND) winId());
+#else
+    return true;
+#endif
+}
+
+void WebWidget::updateVisibility()
+{
+    if (isExposed())
+    {
+        m_freezeTimer->stop();
+
+        if (!m_pageActive)
+        {
+            setPageActive(true);
+            emit WebWidgetVisibilityChanged(this, true);
+        }
+    }
+    else if (m_pageActive && !m_freezeTimer->isActive())
+    {
+        m_freezeTimer->start();
+    }
+}
+
+void WebWidget::setPageActive(bool active)
+{
+    m_pageActive = active;
+
+    int discardSecs = ConfigStore::instance()->value(QUASAR_CONFIG_DISCARDTIMEOUT, 0).toInt();
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QWebEnginePage* page = webview->page();
+
+    if (active)
+    {
+        m_discardTimer->stop();
+
+        // A discarded page is reloaded automatically
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+        page->setVisible(true);
+    }
+    else
+    {
+        // Page must be invisible before it can be frozen
+        page->setVisible(false);
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Frozen);
+
+        if (discardSecs > 0)
+        {
+            m_discardTimer->start(discardSecs * 1000);
+        }
+    }
+#else
+    Q_UNUSED(discardSecs);
+#endif
+
+    qDebug() << "Widget " << m_Name << (active ? " resumed" : " frozen");
+}
+
 void WebWidget::toggleOnTop(bool ontop)
 {
     auto flags = windowFlags();
@@ -81,6 +81,11 @@ public:
     {
     }
 
+    QuasarWebPage(QWebEngineProfile* profile, QObject* parent = Q_NULLPTR)
+        : QWebEnginePage{ profile, parent }
+    {
+    }
+
 protected:
     virtual void javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString& message, int lineNumber, const QString& sourceID);
 };
@@ -103,24 +108,37 @@ public:
 
     QString getFullPath();
 
+    bool isPageActive() { return m_pageActive; }
+
     void saveSettings();
 
 signals:
     void WebWidgetClosed(WebWidget* widget);
+    void WebWidgetLoadFinished(WebWidget* widget, bool ok);
+    void WebWidgetVisibilityChanged(WebWidget* widget, bool visible);
 
 protected:
     void createContextMenuActions();
     void createContextMenu();
 
+    bool isExposed();
+    void updateVisibility();
+    void setPageActive(bool active);
+
     // Overrides
     virtual void mousePressEvent(QMouseEvent* evt) override;
     virtual void mouseMoveEvent(QMouseEvent* evt) override;
+    virtual void showEvent(QShowEvent* evt) override;
+    virtual void hideEvent(QHideEvent* evt) override;
+    virtual void changeEvent(QEvent* evt) override;
+    virtual bool eventFilter(QObject* obj, QEvent* evt) override;
 
 protected slots:
     void toggleOnTop(bool ontop);
 
 private:
-    explicit WebWidget(QString widgetName, const QJsonObject& dat, QWidget* parent = Q_NULLPTR);
+    // A given profile is owned by the widget's page from then on
+    explicit WebWidget(QString widgetName, const QJsonObject& dat, QWebEngineProfile* profile = Q_NULLPTR, QWidget* parent = Q_NULLPTR);
     WebWidget(const WebWidget&) = delete;
     WebWidget& operator=(const WebWidget&) = delete;
 
@@ -130,6 +148,12 @@ private:
 
     bool m_fixedposition = false;
 
+    // Page lifecycle
+    bool    m_pageActive = true;
+    QTimer* m_freezeTimer;
+    QTimer* m_discardTimer;
+    QTimer* m_occlusionTimer = nullptr; // Windows only
+
     QString m_Name;
 
     // Web engine widget
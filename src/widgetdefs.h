@@ -8,6 +8,7 @@
 #define WGT_DEF_TRANSPARENTBG "transparentBg"
 #define WGT_DEF_REMOTEACCESS "remoteAccess"
 #define WGT_DEF_CLICKABLE "clickable"
+#define WGT_DEF_PRIORITY "priority"
 
 #define QUASAR_CONFIG_PORT "global/dataport"
 #define QUASAR_CONFIG_LOADED "global/loaded"
@@ -16,7 +17,16 @@
 #define QUASAR_CONFIG_COOKIES "global/cookies"
 #define QUASAR_CONFIG_ALLOWGEO "global/allowGeo"
 #define QUASAR_CONFIG_LASTPATH "global/lastpath"
+#define QUASAR_CONFIG_LOADCONCURRENCY "global/loadConcurrency"
+#define QUASAR_CONFIG_SHAREDRENDERER "global/sharedRenderer"
+#define QUASAR_CONFIG_RENDERERLIMIT "global/rendererLimit"
+#define QUASAR_CONFIG_DISCARDTIMEOUT "global/discardAfter"
 
 #define QUASAR_CONFIG_DEFAULT_LOGLEVEL QUASAR_LOG_WARNING
+#define QUASAR_CONFIG_DEFAULT_LOADCONCURRENCY 2
+
+#define QUASAR_WIDGET_LOAD_TIMEOUT 15000
+#define QUASAR_WIDGET_FREEZE_DELAY 1000
+#define QUASAR_WIDGET_OCCLUSION_INTERVAL 1000
 
 #define QUASAR_DATA_SERVER_DEFAULT_PORT 13337
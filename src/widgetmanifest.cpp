@@ -0,0 +1,162 @@
+#include "widgetmanifest.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+    constexpr quint32 MANIFEST_MAGIC   = 0x514d4e46; // QMNF
+    constexpr quint32 MANIFEST_VERSION = 1;
+
+    const char* MANIFEST_FILENAME = "widgets.manifest";
+}
+
+WidgetManifest::~WidgetManifest()
+{
+    save();
+}
+
+WidgetManifest::WidgetManifest()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+
+    QDir().mkpath(dir);
+    m_path = dir + "/" + MANIFEST_FILENAME;
+
+    load();
+}
+
+bool WidgetManifest::lookup(const QFileInfo& info, QJsonObject& dat)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_entries.find(info.absoluteFilePath());
+
+    if (it == m_entries.end() ||
+        it->second.mtime != info.lastModified().toMSecsSinceEpoch() ||
+        it->second.size != info.size())
+    {
+        return false;
+    }
+
+    it->second.seen = true;
+
+    dat = it->second.def;
+    return true;
+}
+
+void WidgetManifest::insert(const QFileInfo& info, const QJsonObject& dat)
+{
+    QMutexLocker lock(&m_mutex);
+
+    m_entries[info.absoluteFilePath()] = { info.lastModified().toMSecsSinceEpoch(), info.size(), dat, true };
+    m_dirty                            = true;
+}
+
+void WidgetManifest::load()
+{
+    QFile file(m_path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+
+    // One read for the whole manifest
+    QByteArray  buf = file.readAll();
+    QDataStream in(buf);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+
+    if (in.status() != QDataStream::Ok || magic != MANIFEST_MAGIC || version != MANIFEST_VERSION)
+    {
+        qInfo() << "Discarding outdated widget manifest";
+        return;
+    }
+
+    m_entries.reserve(count);
+
+    for (quint32 i = 0; i < count; i++)
+    {
+        QString     path;
+        qint64      mtime, size;
+        QVariantMap def;
+
+        in >> path >> mtime >> size >> def;
+
+        if (in.status() != QDataStream::Ok)
+        {
+            qWarning() << "Widget manifest is corrupt, rebuilding";
+            m_entries.clear();
+            return;
+        }
+
+        m_entries[path] = { mtime, size, QJsonObject::fromVariantMap(def), false };
+    }
+}
+
+void WidgetManifest::save(bool prune)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (prune)
+    {
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            // Entries used since load are known to be current, the rest are checked on disk
+            bool stale = false;
+
+            if (!it->second.seen)
+            {
+                QFileInfo info(it->first);
+
+                stale = !info.exists() ||
+                        it->second.mtime != info.lastModified().toMSecsSinceEpoch() ||
+                        it->second.size != info.size();
+            }
+
+            if (stale)
+            {
+                it      = m_entries.erase(it);
+                m_dirty = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    if (!m_dirty)
+    {
+        return;
+    }
+
+    QByteArray  buf;
+    QDataStream out(&buf, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << MANIFEST_MAGIC << MANIFEST_VERSION << (quint32) m_entries.size();
+
+    for (const auto& e : m_entries)
+    {
+        out << e.first << e.second.mtime << e.second.size << e.second.def.toVariantMap();
+    }
+
+    QSaveFile file(m_path);
+
+    if (!file.open(QIODevice::WriteOnly) || file.write(buf) != buf.size() || !file.commit())
+    {
+        qWarning() << "Failed to write widget manifest" << m_path;
+        return;
+    }
+
+    m_dirty = false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <qstring_hash_impl.h>
+
+#include <QJsonObject>
+#include <QMutex>
+#include <unordered_map>
+
+QT_FORWARD_DECLARE_CLASS(QFileInfo)
+
+// Cache of validated widget definitions, stored as a single binary file.
+// Entries are keyed by absolute path and invalidated when the
+// definition file's modification time or size changes.
+class WidgetManifest
+{
+public:
+    ~WidgetManifest();
+    WidgetManifest();
+    WidgetManifest(const WidgetManifest&) = delete;
+    WidgetManifest& operator=(const WidgetManifest&) = delete;
+
+    bool lookup(const QFileInfo& info, QJsonObject& dat);
+    void insert(const QFileInfo& info, const QJsonObject& dat);
+
+    // Writes the manifest out if anything changed. With prune, entries whose file was
+    // deleted, renamed or changed since it was cached are dropped first, so they do not
+    // linger. Entries of widgets that are merely closed stay for when they are reopened
+    void save(bool prune = false);
+
+private:
+    struct ManifestEntry
+    {
+        qint64      mtime;
+        qint64      size;
+        QJsonObject def;
+        bool        seen; // looked up or inserted since load
+    };
+
+    void load();
+
+    QString                       m_path;
+    QMutex                        m_mutex;
+    QStringHashMap<ManifestEntry> m_entries;
+    bool                          m_dirty = false;
+};
@@ -1,12 +1,20 @@
 #include "widgetregistry.h"
 
+#include "configstore.h"
+#include "startupprofiler.h"
 #include "webwidget.h"
 #include "widgetdefs.h"
 
+#include <QFileInfo>
 #include <QNetworkCookie>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
 #include <QtWebEngineCore/QWebEngineCookieStore>
 #include <QtWebEngineWidgets/QWebEngineProfile>
 
+#include <algorithm>
+
 namespace
 {
     enum NetscapeCookieFormat
@@ -22,18 +30,96 @@ namespace
     };
 }
 
+class WidgetDefinitionReader : public QRunnable
+{
+public:
+    WidgetDefinitionReader(QStringList files, WidgetRegistry* reg)
+        : m_files(files), m_reg(reg) {}
+
+    void run() override
+    {
+        QJsonArray defs;
+
+        for (const QString& f : m_files)
+        {
+            QJsonObject dat;
+
+            if (m_reg->readWidgetDefinition(f, dat))
+            {
+                defs.append(dat);
+            }
+        }
+
+        // Drop entries of definitions that are gone or changed
+        m_reg->m_manifest.save(true);
+
+        QMetaObject::invokeMethod(m_reg, "queueWidgetDefinitions", Qt::QueuedConnection, Q_ARG(QJsonArray, defs));
+    }
+
+private:
+    QStringList     m_files;
+    WidgetRegistry* m_reg;
+};
+
 WidgetRegistry::WidgetRegistry(QObject* parent)
     : QObject(parent)
 {
+    // Read once, the renderer flags were fixed at startup
+    m_sharedRenderer = ConfigStore::instance()->value(QUASAR_CONFIG_SHAREDRENDERER, false).toBool();
+
     loadCookies();
 }
 
 WidgetRegistry::~WidgetRegistry()
 {
+    QThreadPool::globalInstance()->waitForDone();
+
     m_widgetMap.clear();
 }
 
 bool WidgetRegistry::loadWebWidget(QString filename, bool userAction)
+{
+    QJsonObject dat;
+
+    if (!readWidgetDefinition(filename, dat))
+    {
+        return false;
+    }
+
+    if (userAction && !WebWidget::acceptSecurityWarnings(dat))
+    {
+        qWarning() << "Denied loading '" << filename << "'";
+        return false;
+    }
+
+    m_manifest.save();
+
+    WebWidget* widget = createWebWidget(dat, userAction);
+
+    return (nullptr != widget);
+}
+
+void WidgetRegistry::loadWebWidgets(QStringList filenames)
+{
+    if (filenames.isEmpty())
+    {
+        // Drop entries of definitions that are gone or changed
+        m_manifest.save(true);
+
+        QTimer::singleShot(0, this, &WidgetRegistry::widgetsLoaded);
+        return;
+    }
+
+    m_loadLimit = std::max(1, ConfigStore::instance()->value(QUASAR_CONFIG_LOADCONCURRENCY, QUASAR_CONFIG_DEFAULT_LOADCONCURRENCY).toInt());
+
+    m_loadTimer.start();
+    StartupProfiler::begin("Widget definitions");
+
+    // Read and validate all definitions off the GUI thread
+    QThreadPool::globalInstance()->start(new WidgetDefinitionReader(filenames, this));
+}
+
+bool WidgetRegistry::readWidgetDefinition(QString filename, QJsonObject& dat)
 {
     if (filename.isNull())
     {
@@ -41,6 +127,14 @@ bool WidgetRegistry::loadWebWidget(QString filename, bool userAction)
         return false;
     }
 
+    QFileInfo info(filename);
+
+    // Unchanged definitions were already parsed and validated
+    if (m_manifest.lookup(info, dat))
+    {
+        return true;
+    }
+
     QFile wgtFile(filename);
 
     if (!wgtFile.open(QIODevice::ReadOnly))
@@ -52,7 +146,7 @@ bool WidgetRegistry::loadWebWidget(QString filename, bool userAction)
     QByteArray    wgtDat = wgtFile.readAll();
     QJsonDocument loadDoc(QJsonDocument::fromJson(wgtDat));
 
-    QJsonObject dat       = loadDoc.object();
+    dat                   = loadDoc.object();
     dat[WGT_DEF_FULLPATH] = filename;
 
     if (!WebWidget::validateWidgetDefinition(dat))
@@ -61,12 +155,13 @@ bool WidgetRegistry::loadWebWidget(QString filename, bool userAction)
         return false;
     }
 
-    if (userAction && !WebWidget::acceptSecurityWarnings(dat))
-    {
-        qWarning() << "Denied loading '" << filename << "'";
-        return false;
-    }
+    m_manifest.insert(info, dat);
+
+    return true;
+}
 
+WebWidget* WidgetRegistry::createWebWidget(const QJsonObject& dat, bool userAction)
+{
     // Generate unique widget name
     QString defName    = dat[WGT_DEF_NAME].toString();
     QString widgetName = defName;
@@ -79,23 +174,121 @@ bool WidgetRegistry::loadWebWidget(QString filename, bool userAction)
 
     qInfo() << "Loading widget " << widgetName << " (" << dat[WGT_DEF_FULLPATH].toString() << ")";
 
-    WebWidget* widget = new WebWidget(widgetName, dat);
+    QWebEngineProfile* profile = nullptr;
+
+    if (m_sharedRenderer && dat[WGT_DEF_REMOTEACCESS].toBool())
+    {
+        // --process-per-site applies to every page, so a widget with remote access gets
+        // a profile of its own. Renderer processes are never shared across profiles
+        profile = new QWebEngineProfile();
+        profile->setPersistentCookiesPolicy(QWebEngineProfile::NoPersistentCookies);
+
+        for (const QNetworkCookie& cookie : m_cookies)
+        {
+            profile->cookieStore()->setCookie(cookie);
+        }
+    }
+
+    WebWidget* widget = new WebWidget(widgetName, dat, profile);
 
     m_widgetMap.insert(std::make_pair(widgetName, widget));
 
     connect(widget, &WebWidget::WebWidgetClosed, this, &WidgetRegistry::closeWebWidget);
+    connect(widget, &WebWidget::WebWidgetVisibilityChanged, this, [this](WebWidget* w, bool visible) {
+        emit widgetVisibilityChanged(w->getName(), visible);
+    });
     widget->show();
 
     if (userAction)
     {
         // Add to loaded
-        QSettings   settings;
-        QStringList loaded = settings.value(QUASAR_CONFIG_LOADED).toStringList();
+        ConfigStore& settings = *ConfigStore::instance();
+        QStringList  loaded   = settings.value(QUASAR_CONFIG_LOADED).toStringList();
         loaded.append(widget->getFullPath());
         settings.setValue(QUASAR_CONFIG_LOADED, loaded);
     }
 
-    return true;
+    return widget;
+}
+
+void WidgetRegistry::loadNextWidgets()
+{
+    while (!m_pending.empty() && (int) m_loading.size() < m_loadLimit)
+    {
+        QJsonObject dat = m_pending.front();
+        m_pending.pop_front();
+
+        WebWidget* widget = createWebWidget(dat, false);
+
+        StartupProfiler::begin("Widget load: " + widget->getName());
+
+        m_loading.insert(widget);
+        connect(widget, &WebWidget::WebWidgetLoadFinished, this, &WidgetRegistry::widgetLoadFinished);
+
+        // Don't let a stalled page hold up the rest of the queue
+        QTimer::singleShot(QUASAR_WIDGET_LOAD_TIMEOUT, widget, [this, widget] {
+            if (m_loading.count(widget))
+            {
+                qWarning() << "Widget " << widget->getName() << " timed out while loading";
+                widgetLoadFinished(widget, false);
+            }
+        });
+    }
+
+    if (m_pending.empty() && m_loading.empty() && m_loadTimer.isValid())
+    {
+        qInfo() << "All" << m_loadCount << "widgets loaded in" << m_loadTimer.elapsed() << "ms";
+        m_loadTimer.invalidate();
+
+        emit widgetsLoaded();
+    }
+}
+
+void WidgetRegistry::queueWidgetDefinitions(QJsonArray defs)
+{
+    for (const QJsonValue& v : defs)
+    {
+        m_pending.push_back(v.toObject());
+    }
+
+    // Higher priority widgets get their views created first,
+    // otherwise preserve the saved load order
+    std::stable_sort(m_pending.begin(), m_pending.end(), [](const QJsonObject& a, const QJsonObject& b) {
+        return a[WGT_DEF_PRIORITY].toInt() > b[WGT_DEF_PRIORITY].toInt();
+    });
+
+    qInfo() << "Read" << defs.count() << "widget definitions in" << m_loadTimer.elapsed() << "ms";
+    StartupProfiler::end("Widget definitions");
+
+    loadNextWidgets();
+}
+
+void WidgetRegistry::widgetLoadFinished(WebWidget* widget, bool ok)
+{
+    if (!m_loading.erase(widget))
+    {
+        // Only track the initial page load
+        return;
+    }
+
+    disconnect(widget, &WebWidget::WebWidgetLoadFinished, this, &WidgetRegistry::widgetLoadFinished);
+
+    StartupProfiler::end("Widget load: " + widget->getName());
+
+    m_loadCount++;
+
+    if (!m_firstShown)
+    {
+        m_firstShown = true;
+        qInfo() << "First widget loaded in" << m_loadTimer.elapsed() << "ms";
+    }
+
+    if (!ok)
+    {
+        qWarning() << "Widget " << widget->getName() << " failed to load";
+    }
+
+    loadNextWidgets();
 }
 
 WebWidget* WidgetRegistry::findWidget(QString widgetName)
@@ -112,8 +305,7 @@ WebWidget* WidgetRegistry::findWidget(QString widgetName)
 
 void WidgetRegistry::loadCookies()
 {
-    QSettings settings;
-    QString   cookiesfile = settings.value(QUASAR_CONFIG_COOKIES).toString();
+    QString cookiesfile = ConfigStore::instance()->value(QUASAR_CONFIG_COOKIES).toString();
 
     if (cookiesfile.isEmpty())
     {
@@ -121,10 +313,13 @@ void WidgetRegistry::loadCookies()
         return;
     }
 
+    StartupProfiler::begin("Cookie import");
+
     QFile file(cookiesfile);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
         qWarning() << "Failed to load cookies file " << cookiesfile;
+        StartupProfiler::end("Cookie import");
         return;
     }
 
@@ -159,8 +354,11 @@ void WidgetRegistry::loadCookies()
         cookie.setSecure(vals[NETSCAPE_COOKIE_SECURE] == "TRUE");
 
         store->setCookie(cookie);
+        m_cookies.append(cookie);
     }
 
+    StartupProfiler::end("Cookie import");
+
     qInfo() << "Cookies file " << cookiesfile << "loaded";
 }
 
@@ -171,6 +369,12 @@ void WidgetRegistry::closeWebWidget(WebWidget* widget)
 
     qInfo() << "Closing widget " << name << " (" << widget->getFullPath() << ")";
 
+    // Free up its load slot if it was closed before finishing
+    if (m_loading.erase(widget))
+    {
+        loadNextWidgets();
+    }
+
     // Remove from registry
     auto it = m_widgetMap.find(name);
 
@@ -1,18 +1,26 @@
 #pragma once
 
+#include "widgetmanifest.h"
+
 #include <qstring_hash_impl.h>
 
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QNetworkCookie>
 #include <QObject>
+#include <deque>
 #include <memory>
+#include <set>
 #include <unordered_map>
 
 QT_FORWARD_DECLARE_CLASS(WebWidget);
 
-using WidgetMapType = std::unordered_map<QString, std::unique_ptr<WebWidget>>;
+using WidgetMapType = QStringHashMap<std::unique_ptr<WebWidget>>;
 
 class WidgetRegistry : public QObject
 {
     friend class DataServices;
+    friend class WidgetDefinitionReader;
 
     Q_OBJECT
 
@@ -20,17 +28,30 @@ public:
     ~WidgetRegistry();
 
     bool loadWebWidget(QString filename, bool userAction = true);
+    void loadWebWidgets(QStringList filenames);
 
     WidgetMapType& getWidgets() { return m_widgetMap; }
 
     WebWidget* findWidget(QString widgetName);
 
+    bool readWidgetDefinition(QString filename, QJsonObject& dat);
+
 private:
-    void loadCookies();
+    void       loadCookies();
+    WebWidget* createWebWidget(const QJsonObject& dat, bool userAction);
+    void       loadNextWidgets();
+
+signals:
+    void widgetVisibilityChanged(QString widgetName, bool visible);
+    void widgetsLoaded();
 
 public slots:
     void closeWebWidget(WebWidget* widget);
 
+private slots:
+    void queueWidgetDefinitions(QJsonArray defs);
+    void widgetLoadFinished(WebWidget* widget, bool ok);
+
 private:
     explicit WidgetRegistry(QObject* parent = Q_NULLPTR);
     WidgetRegistry(const WidgetRegistry&) = delete;
@@ -38,5 +59,18 @@ private:
     WidgetRegistry& operator=(const WidgetRegistry&) = delete;
     WidgetRegistry& operator=(WidgetRegistry&&) = delete;
 
-    WidgetMapType m_widgetMap;
+    WidgetMapType  m_widgetMap;
+    WidgetManifest m_manifest;
+
+    // Imported cookies, also set on the profiles of isolated widgets
+    QList<QNetworkCookie> m_cookies;
+    bool                  m_sharedRenderer = false;
+
+    // Staged startup loading
+    std::deque<QJsonObject> m_pending;
+    std::set<WebWidget*>    m_loading;
+    QElapsedTimer           m_loadTimer;
+    int                     m_loadLimit  = 1;
+    int                     m_loadCount  = 0;
+    bool                    m_firstShown = false;
 };
@@ -12,7 +12,8 @@ $(document).ready(function() {
 
         reg["widget"] = qWidgetName;
         reg["type"] = "subscribe";
-        reg["plugin"] = "win_audio_viz";
+        // same spectrum from the Linux pipe/WAV capture plugin
+        reg["plugin"] = navigator.platform.indexOf("Linux") == 0 ? "linux_audio_viz" : "win_audio_viz";
         reg["source"] = "viz";
 
         websocket.send(JSON.stringify(reg));